@@ -0,0 +1,112 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+/**
+  @file event_queue
+
+  Compares the transport event queues by moving a stream of event
+  pointers from a producer thread (standing in for the asio event loop)
+  to a consumer thread (standing in for wait_for_next_event).
+
+  Build from the top source directory with:
+
+    g++ -O2 -Iinclude benchmark/event_queue.cpp -o event_queue -lpthread
+
+  Usage: event_queue [events] [queue size]
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include "bounded_buffer.h"
+#include "spsc_queue.h"
+
+struct Fake_event
+{
+  unsigned long seqno;
+};
+
+template <class Queue>
+struct Run
+{
+  Queue *queue;
+  unsigned long count;
+  Fake_event *events;
+};
+
+template <class Queue>
+static void *produce(void *data)
+{
+  Run<Queue> *run= static_cast<Run<Queue> *>(data);
+  for (unsigned long i= 0; i < run->count; ++i)
+    run->queue->push_front(&run->events[i & 1023]);
+  return NULL;
+}
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+template <class Queue>
+static void bench(const char *name, unsigned long count, size_t size)
+{
+  Queue queue(size);
+  Fake_event events[1024];
+  for (int i= 0; i < 1024; ++i)
+    events[i].seqno= i;
+
+  Run<Queue> run;
+  run.queue= &queue;
+  run.count= count;
+  run.events= events;
+
+  double start= now();
+  pthread_t producer;
+  pthread_create(&producer, NULL, &produce<Queue>, &run);
+
+  unsigned long checksum= 0;
+  for (unsigned long i= 0; i < count; ++i)
+  {
+    Fake_event *ev;
+    queue.pop_back(&ev);
+    checksum+= ev->seqno;
+  }
+  pthread_join(producer, NULL);
+  double elapsed= now() - start;
+
+  std::cout << name << ": " << count << " events in " << elapsed << " s, "
+            << (unsigned long)(count / elapsed) << " events/s"
+            << " (checksum " << checksum << ")" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long count= argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+  size_t size= argc > 2 ? strtoul(argv[2], NULL, 10) : 256;
+
+  bench<bounded_buffer<Fake_event *> >("bounded_buffer", count, size);
+  bench<spsc_queue<Fake_event *> >("spsc_queue    ", count, size);
+  return 0;
+}
@@ -0,0 +1,115 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+/**
+  @file parallel_decode
+
+  Measures catch-up decoding of a binlog file with a Parallel_decoder
+  for an increasing number of workers. Every pass reads the whole file,
+  submits each rows event with its table map and takes the results in
+  order, the way a consumer falling behind the master would.
+
+  Build from the top source directory, after building the library, with:
+
+    g++ -O2 -Iinclude -Iinclude/asio benchmark/parallel_decode.cpp \
+      -o parallel_decode lib/libreplication.a -lcrypto -lpthread
+
+  Usage: parallel_decode binlog-file [max workers]
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <sys/time.h>
+
+#include "binlog_api.h"
+
+using namespace mysql;
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static unsigned long take(Parallel_decoder &decoder)
+{
+  Decoded_event *result= decoder.next();
+  unsigned long images= 0;
+  for (size_t i= 0; i < result->rows.size(); ++i)
+    images+= result->rows[i].images.size();
+  delete result;
+  return images;
+}
+
+static void bench(const char *file_name, size_t workers)
+{
+  Binary_log binlog(system::create_transport(file_name));
+  if (binlog.connect())
+  {
+    std::cerr << "Can't open " << file_name << std::endl;
+    exit(1);
+  }
+
+  Parallel_decoder decoder(workers);
+  Table_map_event *table_map= 0;
+  Binary_log_event *event;
+  unsigned long images= 0;
+
+  double start= now();
+  while (binlog.wait_for_next_event(&event) == ERR_OK)
+  {
+    if (event->get_event_type() == TABLE_MAP_EVENT)
+    {
+      if (table_map)
+        binlog.release(table_map);
+      table_map= static_cast<Table_map_event *>(event);
+      continue;
+    }
+    while (decoder.full())
+      images+= take(decoder);
+    decoder.submit(event, table_map);
+  }
+  while (decoder.pending() > 0)
+    images+= take(decoder);
+  double elapsed= now() - start;
+
+  if (table_map)
+    binlog.release(table_map);
+
+  std::cout << workers << " workers: " << images << " row images in "
+            << elapsed << " s, " << (unsigned long)(images / elapsed)
+            << " images/s" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: parallel_decode binlog-file [max workers]"
+              << std::endl;
+    return 2;
+  }
+  size_t max_workers= argc > 2 ? strtoul(argv[2], NULL, 10) : 8;
+
+  for (size_t workers= 1; workers <= max_workers; workers*= 2)
+    bench(argv[1], workers);
+  return 0;
+}
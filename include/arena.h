@@ -0,0 +1,149 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _ARENA_H
+#define	_ARENA_H
+
+#include <stddef.h>
+#include <new>
+#include <vector>
+
+/* The size of the first block of an arena; later blocks double up to the max */
+#define ARENA_BLOCK_SIZE (16 * 1024)
+#define ARENA_MAX_BLOCK_SIZE (1024 * 1024)
+
+namespace mysql {
+
+/**
+ * A bump pointer allocator. Memory is carved out of large blocks and only
+ * given back when the arena is cleared or destroyed, which frees all of
+ * it with one call per block. Not thread safe.
+ */
+class Arena
+{
+public:
+  explicit Arena(size_t block_size= ARENA_BLOCK_SIZE);
+  ~Arena();
+
+  /**
+   * Allocate size bytes aligned for any type.
+   */
+  void *allocate(size_t size)
+  {
+    size= (size + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1);
+    if (size > (size_t) (m_end - m_ptr))
+      return allocate_block(size);
+    void *p= m_ptr;
+    m_ptr+= size;
+    return p;
+  }
+
+  /**
+   * Free all memory allocated from the arena. Objects living in it aren't
+   * destroyed.
+   */
+  void clear();
+
+  /** The number of bytes held in blocks */
+  size_t capacity() const { return m_capacity; }
+
+private:
+  Arena(const Arena&);                          // Disabled copy constructor
+  Arena& operator = (const Arena&);             // Disabled assign operator
+
+  enum { ALIGNMENT= 16 };
+
+  void *allocate_block(size_t size);
+
+  std::vector<char *> m_blocks;
+  char *m_ptr;
+  char *m_end;
+  size_t m_block_size;
+  size_t m_capacity;
+};
+
+/**
+ * A standard allocator which takes its memory from an Arena, for
+ * containers which live no longer than the arena. Deallocation is a no-op;
+ * the memory is reclaimed with the arena. A default constructed allocator
+ * has no arena and uses the heap.
+ */
+template <class T>
+class Arena_allocator
+{
+public:
+  typedef T value_type;
+  typedef T *pointer;
+  typedef const T *const_pointer;
+  typedef T &reference;
+  typedef const T &const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template <class U>
+  struct rebind { typedef Arena_allocator<U> other; };
+
+  Arena_allocator() : m_arena(0) {}
+  explicit Arena_allocator(Arena *arena) : m_arena(arena) {}
+  template <class U>
+  Arena_allocator(const Arena_allocator<U> &other) : m_arena(other.arena()) {}
+
+  Arena *arena() const { return m_arena; }
+
+  pointer address(reference x) const { return &x; }
+  const_pointer address(const_reference x) const { return &x; }
+
+  pointer allocate(size_type n, const void * = 0)
+  {
+    if (m_arena)
+      return static_cast<pointer>(m_arena->allocate(n * sizeof(T)));
+    return static_cast<pointer>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(pointer p, size_type)
+  {
+    if (m_arena == 0)
+      ::operator delete(p);
+  }
+
+  size_type max_size() const { return (size_type) -1 / sizeof(T); }
+
+  void construct(pointer p, const T &value) { new ((void *) p) T(value); }
+  void destroy(pointer p) { p->~T(); }
+
+private:
+  Arena *m_arena;
+};
+
+template <class T, class U>
+bool operator==(const Arena_allocator<T> &a, const Arena_allocator<U> &b)
+{
+  return a.arena() == b.arena();
+}
+
+template <class T, class U>
+bool operator!=(const Arena_allocator<T> &a, const Arena_allocator<U> &b)
+{
+  return a.arena() != b.arena();
+}
+
+} // end namespace mysql
+
+#endif	/* _ARENA_H */
@@ -20,6 +20,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 #ifndef BASIC_CONTENT_HANDLER_H
 #define	BASIC_CONTENT_HANDLER_H
 
+#include <typeinfo>
 #include "binlog_event.h"
 
 namespace mysql {
@@ -31,6 +32,26 @@ public:
     ~Injection_queue() {}
 };
 
+/**
+ * The groups of events which Content_handler::internal_process_event()
+ * routes to one process_event() overload each. Events without a
+ * dedicated overload, INTVAR_EVENT included, are HANDLES_OTHER.
+ */
+enum Handled_events
+{
+  HANDLES_QUERY= 1 << 0,
+  HANDLES_ROWS= 1 << 1,
+  HANDLES_TABLE_MAP= 1 << 2,
+  HANDLES_XID= 1 << 3,
+  HANDLES_USER_VAR= 1 << 4,
+  HANDLES_INCIDENT= 1 << 5,
+  HANDLES_ROTATE= 1 << 6,
+  HANDLES_OTHER= 1 << 7,
+  HANDLES_ALL= 0xff
+};
+
+template <class Handler, class Next> class Static_stage;
+
 /**
  * A content handler accepts an event and returns the same event,
  * a new one or 0 (the event was consumed by the content handler).
@@ -46,6 +67,23 @@ public:
   Content_handler(const mysql::Content_handler& orig);
   virtual ~Content_handler();
 
+  /**
+   * The Handled_events bits of the overloads the handler overrides. A
+   * derived handler which only overrides some of them may narrow this so
+   * that a Static_pipeline never calls it for the others; it must then
+   * also name itself as handled_events_class. A class derived from it
+   * which doesn't do the same is called for all overloads.
+   */
+  enum { handled_events= HANDLES_ALL };
+  typedef Content_handler handled_events_class;
+
+  /**
+   * The types of the events the handler wants to see. Binary_log skips
+   * the handler for other events. All types unless the handler narrowed
+   * them with subscribe() or subscribe_overloads().
+   */
+  const system::Event_type_mask &subscribed_events() const;
+
   virtual mysql::Binary_log_event *process_event(mysql::Query_event *ev);
   virtual mysql::Binary_log_event *process_event(mysql::Row_event *ev);
   virtual mysql::Binary_log_event *process_event(mysql::Table_map_event *ev);
@@ -68,12 +106,41 @@ protected:
    */
   Injection_queue *get_injection_queue();
 
+  /**
+   * Only receive events of the given types. Call it from the constructor
+   * or before the handler is added to a pipeline.
+   */
+  void subscribe(const system::Event_type_mask &types)
+  {
+    m_subscribed_events= types;
+    m_overloads_class= 0;
+  }
+
+  /**
+   * Only receive the events of the overloads in handled, a combination of
+   * Handled_events; usually subscribe_overloads(handled_events).
+   *
+   * The narrowing only holds for the class whose constructor calls it. A
+   * class derived from that one may override any of the other overloads,
+   * so its objects receive the events of all of them, or those given to
+   * subscribe(), unless its own constructor calls subscribe_overloads()
+   * again.
+   */
+  void subscribe_overloads(int handled);
+
 private:
   Injection_queue *m_reinject_queue;
+  system::Event_type_mask m_subscribed_events;
+  /** The types of the overloads given to subscribe_overloads() */
+  system::Event_type_mask m_overload_events;
+  /** The class which called subscribe_overloads(), or 0 */
+  const std::type_info *m_overloads_class;
   void set_injection_queue(Injection_queue *injection_queue);
   mysql::Binary_log_event *internal_process_event(mysql::Binary_log_event *ev);
 
   friend class Binary_log;
+  friend class Threaded_pipeline;
+  template <class Handler, class Next> friend class Static_stage;
 };
 
 } // end namespace
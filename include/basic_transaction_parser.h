@@ -28,42 +28,285 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 
 #include <list>
 #include <stdint.h>
+#include <stdio.h>
 #include <map>
+#include <string>
 #include <utility>
+#include <vector>
 #include "binlog_event.h"
 #include "basic_content_handler.h"
+#include "arena.h"
+#include "event_buffer.h"
 
 #include <iostream>
 
 namespace mysql {
 typedef std::pair<uint64_t, Binary_log_event *> Event_index_element;
-typedef std::map<uint64_t, Binary_log_event *> Int_to_Event_map;
+typedef std::map<uint64_t, Binary_log_event *, std::less<uint64_t>,
+                 Arena_allocator<Event_index_element> > Int_to_Event_map;
+typedef std::list<Binary_log_event *,
+                  Arena_allocator<Binary_log_event *> > Event_list;
+
+/**
+ * The events of one transaction. The list and the table index are
+ * allocated from an arena which belongs to the transaction, so that they
+ * are freed all at once with it. The events belong to the event pool of
+ * the driver and are returned to it in bulk.
+ *
+ * A large transaction may be spilled to a temporary file. Its events and
+ * table index are then empty and the events must be read with a
+ * Transaction_event_reader, which works for both kinds of transactions.
+ */
 class Transaction_log_event : public Binary_log_event
 {
+private:
+    /* Declared first so that it is destroyed after the containers */
+    Arena m_arena;
+
 public:
-    Transaction_log_event() : Binary_log_event() {}
-    Transaction_log_event(Log_event_header *header) : Binary_log_event(header) {}
+    Transaction_log_event();
+    Transaction_log_event(Log_event_header *header);
     virtual ~Transaction_log_event();
 
     Int_to_Event_map &table_map() { return m_table_map; }
+
+    /**
+     * The arena of the transaction, for other data which lives as long
+     * as the transaction.
+     */
+    Arena &arena() { return m_arena; }
+
     /**
      * Index for easier table name look up
      */
     Int_to_Event_map m_table_map;
 
-    std::list<Binary_log_event *> m_events;
+    Event_list m_events;
+
+    /**
+     * Add an event at the end of the transaction. The transaction takes
+     * over the event.
+     */
+    void add_event(Binary_log_event *event);
+
+    /**
+     * The number of events in the transaction, in memory or spilled.
+     */
+    size_t event_count() const { return m_event_count; }
+
+    /**
+     * The memory held by the events in memory: their binlog size, plus the
+     * whole of every receive buffer their row images refer to.
+     */
+    size_t memory_size() const { return m_memory_size; }
+
+    /**
+     * Move the events held in memory to an unlinked temporary file in
+     * directory; later events are appended to the file as they are added.
+     *
+     * @retval 0 Success
+     * @retval 1 The file couldn't be created or written; the events stay
+     *           in memory
+     */
+    int spill(const std::string &directory);
+
+    bool is_spilled() const { return m_spill_file != 0; }
+
+    /**
+     * The sequence number the parser gave the transaction, counting from 1.
+     */
+    uint64_t seq_no;
+
+    /**
+     * True if spilling failed. If the transaction is spilled, events added
+     * after the failure are missing from it, see has_lost_events();
+     * otherwise all events are still in memory.
+     */
+    bool spill_failed() const { return m_spill_failed; }
+
+    /**
+     * True if events couldn't be written to the spill file, so that the
+     * transaction is incomplete. Basic_transaction_parser never returns
+     * such a transaction.
+     */
+    bool has_lost_events() const { return m_spill_file && m_spill_failed; }
+
+    /**
+     * Write out buffered spilled events so that readers see them.
+     */
+    void flush();
+
+private:
+    friend class Transaction_event_reader;
+
+    int write_spilled(Binary_log_event *event);
+    size_t held_size(Binary_log_event *event);
+    void release_events();
+
+    size_t m_event_count;
+    size_t m_memory_size;
+    /** The last buffer counted in m_memory_size */
+    const Event_buffer *m_last_buffer;
+    FILE *m_spill_file;
+    uint64_t m_spill_size;
+    bool m_spill_failed;
+    /** Encoding buffer for spilled events */
+    std::vector<char> m_spill_buffer;
 };
 
 Transaction_log_event *create_transaction_log_event(void);
 
+/**
+ * Marks the start (TRANSACTION_BEGIN_EVENT) or the end
+ * (TRANSACTION_COMMIT_EVENT) of a transaction whose events are streamed by
+ * a Basic_transaction_parser. The table map and rows events in between
+ * carry the same transaction_seq_no.
+ */
+class Transaction_marker_event : public Binary_log_event
+{
+public:
+  Transaction_marker_event(Log_event_header *header)
+    : Binary_log_event(header), seq_no(0), start_time(0), xid(0),
+      has_xid(false)
+  {
+  }
+
+  uint64_t seq_no;
+  /** The timestamp of the start of the transaction */
+  uint32_t start_time;
+  /** The XID of the commit; only set on a commit marker if has_xid */
+  uint64_t xid;
+  bool has_xid;
+};
+
+/**
+ * Reads the events of a transaction in order, from memory or from its
+ * spill file. Spilled events are decoded one at a time, so a spilled
+ * transaction can be processed in bounded memory.
+ *
+ * Example:
+ *   Transaction_event_reader reader(trans);
+ *   while (Binary_log_event *event= reader.next())
+ *     if (event->get_event_type() == WRITE_ROWS_EVENT)
+ *     {
+ *       Row_event *rows= static_cast<Row_event *>(event);
+ *       Row_event_set set(rows, reader.table_map(rows->table_id));
+ *       ...
+ *     }
+ */
+class Transaction_event_reader
+{
+public:
+  explicit Transaction_event_reader(Transaction_log_event *trans);
+  ~Transaction_event_reader();
+
+  /**
+   * Get the next event. An event read from the spill file belongs to the
+   * reader and is valid until the next call; other events belong to the
+   * transaction.
+   *
+   * @return The next event, or 0 at the end of the transaction or if the
+   *         spill file couldn't be read; see error()
+   */
+  Binary_log_event *next();
+
+  /**
+   * The table map event of table_id among the events read so far, or 0.
+   */
+  Table_map_event *table_map(uint64_t table_id);
+
+  bool error() const { return m_error; }
+
+private:
+  Transaction_event_reader(const Transaction_event_reader&);
+  Transaction_event_reader& operator = (const Transaction_event_reader&);
+
+  Binary_log_event *read_spilled();
+
+  Transaction_log_event *m_trans;
+  Event_list::iterator m_it;
+  uint64_t m_offset;
+  Event_buffer *m_buffer;
+  /** The bytes of m_buffer taken by event bodies */
+  size_t m_buffer_used;
+  /** The last event read from the spill file */
+  Binary_log_event *m_current;
+  /** The table maps read from the spill file */
+  std::map<uint64_t, Table_map_event *> m_table_maps;
+  bool m_error;
+};
+
+/* The default size at which ADAPTIVE_MODE starts streaming a transaction */
+#define STREAMING_THRESHOLD (1024 * 1024)
+
 class Basic_transaction_parser : public mysql::Content_handler
 {
 public:
-  Basic_transaction_parser() : mysql::Content_handler()
+  enum Transaction_mode
+  {
+    /**
+     * Return every transaction as one Transaction_log_event at commit.
+     */
+    BUFFERED_MODE,
+    /**
+     * Return table map and rows events as they arrive, tagged with the
+     * sequence number of their transaction, between a begin and a commit
+     * Transaction_marker_event.
+     */
+    STREAMING_MODE,
+    /**
+     * Buffer a transaction until its events exceed the streaming
+     * threshold, then stream it: the buffered events are injected after
+     * a begin marker and the rest follows as in STREAMING_MODE. Small
+     * transactions are returned as in BUFFERED_MODE.
+     */
+    ADAPTIVE_MODE
+  };
+
+  Basic_transaction_parser() : mysql::Content_handler(), m_transaction(0),
+    m_memory_budget(0), m_spill_directory(P_tmpdir), m_mode(BUFFERED_MODE),
+    m_streaming_threshold(STREAMING_THRESHOLD), m_streaming(false),
+    m_seq_no(0)
   {
       m_transaction_state= NOT_IN_PROGRESS;
+      subscribe_overloads(handled_events);
   }
 
+  /**
+   * Choose how transactions are returned. ADAPTIVE_MODE needs the
+   * injection queue of a Binary_log and streams transactions whose events
+   * take more than threshold bytes. A transaction which was already
+   * spilled by the memory budget stays buffered.
+   */
+  void set_mode(Transaction_mode mode,
+                size_t streaming_threshold= STREAMING_THRESHOLD)
+  {
+    m_mode= mode;
+    m_streaming_threshold= streaming_threshold;
+  }
+  ~Basic_transaction_parser();
+
+  /**
+   * Keep at most budget bytes of events of a transaction in memory,
+   * counted as Transaction_log_event::memory_size() does.
+   * A larger transaction is spilled to a temporary file in directory and
+   * must be read with a Transaction_event_reader. A budget of 0, the
+   * default, keeps every transaction in memory.
+   *
+   * If the spill file can't be written, the transaction is dropped and an
+   * Incident_event is returned in its place at the commit.
+   */
+  void set_memory_budget(size_t budget,
+                         const std::string &directory= P_tmpdir)
+  {
+    m_memory_budget= budget;
+    m_spill_directory= directory;
+  }
+
+  enum { handled_events= HANDLES_QUERY | HANDLES_ROWS | HANDLES_TABLE_MAP |
+                         HANDLES_XID };
+  typedef Basic_transaction_parser handled_events_class;
+
   mysql::Binary_log_event *process_event(mysql::Query_event *ev);
   mysql::Binary_log_event *process_event(mysql::Row_event *ev);
   mysql::Binary_log_event *process_event(mysql::Table_map_event *ev);
@@ -74,7 +317,23 @@ private:
   uint32_t m_start_time;
   enum Transaction_states { STARTING, IN_PROGRESS, COMMITTING, NOT_IN_PROGRESS } ;
   enum Transaction_states m_transaction_state;
-  std::list <mysql::Binary_log_event *> m_event_stack;
+  /**
+   * The transaction being collected. Events are added to it as they
+   * arrive rather than copied into it at commit.
+   */
+  mysql::Transaction_log_event *m_transaction;
+  size_t m_memory_budget;
+  std::string m_spill_directory;
+  Transaction_mode m_mode;
+  size_t m_streaming_threshold;
+  /** True while the current transaction is streamed */
+  bool m_streaming;
+  uint64_t m_seq_no;
+
+  void add_event(mysql::Binary_log_event *ev);
+  void start_streaming();
+  Transaction_marker_event *create_marker(Log_event_type type,
+                                          mysql::Binary_log_event *source);
   mysql::Binary_log_event *process_transaction_state(mysql::Binary_log_event *ev);
 };
 
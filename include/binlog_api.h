@@ -23,15 +23,26 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 
 #include <iosfwd>
 #include <list>
+#include <vector>
 #include <cassert>
 #include "binlog_event.h"
 #include "binlog_driver.h"
 #include "tcp_driver.h"
 #include "file_driver.h"
+#include "mmap_driver.h"
+#include "multi_file_driver.h"
+#include "parallel_file_driver.h"
 #include "basic_content_handler.h"
 #include "basic_transaction_parser.h"
 #include "field_iterator.h"
 #include "rowset.h"
+#include "row_index.h"
+#include "column_batch.h"
+#include "parallel_decoder.h"
+#include "table_index.h"
+#include "static_pipeline.h"
+#include "threaded_pipeline.h"
+#include "shard_dispatcher.h"
 #include "access_method_factory.h"
 
 namespace mysql
@@ -77,11 +88,60 @@ private:
   system::Binary_log_driver *m_driver;
   Dummy_driver m_dummy_driver;
   Content_handler_pipeline m_content_handlers;
+  /**
+   * Events injected by content handlers, which are processed before the
+   * next event is pulled from the driver.
+   */
+  Injection_queue m_reinjection_queue;
+  /**
+   * The content handlers as of the last event, and for each event type
+   * the positions among them of the handlers subscribed to the type.
+   */
+  std::vector<Content_handler *> m_dispatch_handlers;
+  std::vector<size_t> m_dispatch[256];
   unsigned long m_binlog_position;
   std::string m_binlog_file;
+  /** The file named by the last rotate event, until an event comes from it */
+  std::string m_next_binlog_file;
+
+  /**
+   * Rebuild the dispatch vectors if the pipeline changed.
+   *
+   * @return True if the pipeline changed
+   */
+  bool update_dispatch();
+
+  /** Runs the content handlers in threaded mode, started on demand */
+  Threaded_pipeline *m_threads;
+  bool m_threaded;
+  size_t m_queue_size;
+  /**
+   * Events which went through the handlers of a pipeline of threads
+   * before it was drained; returned before any other.
+   */
+  std::list<Binary_log_event *> m_drained_events;
+
+  int wait_for_threaded_event(Binary_log_event **event);
+  int next_drained_event(Binary_log_event **event);
+  void discard_drained_events();
+
+  /**
+   * True while the driver is ahead of the events returned, so that the
+   * position is that of the last event returned rather than the driver's.
+   */
+  bool is_reading_ahead() const
+  {
+    return (m_threads && m_threads->is_running()) ||
+           !m_drained_events.empty();
+  }
+
+  /**
+   * Follow the position of the events returned while reading ahead.
+   */
+  void advance_position(Binary_log_event *event);
 public:
   Binary_log(system::Binary_log_driver *drv);
-  ~Binary_log() {}
+  ~Binary_log();
 
   int connect();
 
@@ -94,6 +154,9 @@ public:
   /**
    * Inserts/removes content handlers in and out of the chain
    * The Content_handler_pipeline is a derived std::list
+   *
+   * A handler is only called for the event types in its
+   * Content_handler::subscribed_events(), read when the pipeline changes.
    */
   Content_handler_pipeline *content_handler_pipeline();
 
@@ -118,6 +181,28 @@ public:
    */
   int set_position(unsigned long position);
 
+  /**
+   * Run every content handler on a thread of its own, connected by
+   * bounded queues of queue_size events, with one more thread reading
+   * from the driver; see Threaded_pipeline. Events are returned in the
+   * same order as without threads. An event injected by a handler starts
+   * over at that handler instead of at the first one.
+   *
+   * The threads start with the next wait_for_next_event() and stop when
+   * it returns an error, on set_position() and when threads are turned
+   * off. When threads are turned off or the pipeline changes while they
+   * run, the events already read from the driver still go through the
+   * handlers they started with and are returned before the events read
+   * after the change; none is lost.
+   *
+   * While threads run, the handlers are ahead of the events returned and
+   * change their state in their own threads. The consumer must not call
+   * a handler meanwhile, e.g. Table_index::find(), unless the handler is
+   * documented to be thread safe.
+   */
+  void set_threaded(bool threaded, size_t queue_size= PIPELINE_QUEUE_SIZE);
+  bool is_threaded() const { return m_threaded; }
+
   /**
    * Fetch the binlog position for the current file
    */
@@ -128,9 +213,45 @@ public:
    * @param[out] filename
    * TODO replace reference with a pointer.
    * @return The file position
+   *
+   * While threads read ahead the file and position are those after the
+   * last event returned, as followed through the rotate events, and the
+   * driver isn't asked.
    */
   unsigned long get_position(std::string &filename);
 
+  /**
+   * Dispose of an event returned by wait_for_next_event(). Events parsed by
+   * a driver go back to the driver's pool to be reused, together with the
+   * memory of their strings and vectors; other events are deleted.
+   *
+   * The caller owns every event returned by wait_for_next_event() and
+   * should release it with this function or with release_event(); plain
+   * delete is allowed but doesn't recycle the event. A content handler
+   * which returns 0 from process_event() takes over the event and must
+   * release it the same way once done with it. Events inside a
+   * Transaction_log_event are released together with it.
+   */
+  void release(Binary_log_event *event) { release_event(event); }
+
+  /**
+   * Only fetch events whose type is in mask; see
+   * Binary_log_driver::set_event_mask().
+   */
+  void set_event_mask(const system::Event_type_mask &mask)
+  {
+    m_driver->set_event_mask(mask);
+  }
+
+  /**
+   * Only fetch table map and rows events of the tables which filter
+   * allows; see Binary_log_driver::set_table_filter().
+   */
+  void set_table_filter(const system::Table_filter &filter)
+  {
+    m_driver->set_table_filter(filter);
+  }
+
 };
 
 }
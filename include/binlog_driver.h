@@ -21,8 +21,19 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 #ifndef _BINLOG_DRIVER_H
 #define _BINLOG_DRIVER_H
 
+#include <bitset>
+#include <map>
+#include <set>
 #include "binlog_event.h"
 #include "protocol.h"
+#include "decode_plan.h"
+#include "table_filter.h"
+
+/* The number of tables whose decode plans are kept by a driver */
+#define DECODE_PLAN_CACHE_SIZE 4096
+
+/* The flag of the last rows event of a statement */
+#define ROWS_STMT_END_F 1
 
 namespace mysql {
 namespace system {
@@ -32,11 +43,13 @@ class Binary_log_driver
 public:
   template <class FilenameT>
   Binary_log_driver(const FilenameT& filename = FilenameT(), unsigned int offset = 0)
-    : m_binlog_file_name(filename), m_binlog_offset(offset)
+    : m_binlog_file_name(filename), m_binlog_offset(offset),
+      m_event_pool(new Event_pool()), m_evict_excluded(false)
   {
+    m_event_mask.set();
   }
 
-  ~Binary_log_driver() {}
+  virtual ~Binary_log_driver();
 
   /**
    * Connect to the binary log using previously declared connection parameters
@@ -73,15 +86,133 @@ public:
    */
   virtual int get_position(std::string *filename_ptr, unsigned long *position_ptr) = 0;
 
-  Binary_log_event* parse_event(std::istream &sbuff, Log_event_header *header);
+  /**
+   * Make a wait_for_next_event() blocked in another thread, or the next
+   * one, return ERR_EOF instead of waiting for an event, until resume()
+   * is called. Drivers which never wait for long needn't do anything.
+   */
+  virtual void interrupt() {}
+  virtual void resume() {}
+
+  /**
+   * Only return events whose type is in mask. Other events are stepped
+   * over once their header is read, without decoding their body or
+   * allocating an event. Rotate events are always decoded since the
+   * driver follows the binlog position with them. All types are
+   * subscribed by default.
+   *
+   * Set the mask before connecting; the driver may read it from another
+   * thread.
+   */
+  void set_event_mask(const Event_type_mask &mask) { m_event_mask= mask; }
+  const Event_type_mask &event_mask() const { return m_event_mask; }
+
+  bool is_subscribed(unsigned char type_code) const
+  {
+    return type_code == ROTATE_EVENT || m_event_mask.test(type_code);
+  }
+
+  /**
+   * Only return table map and rows events of the tables which filter
+   * allows. The filter is evaluated once per table map event; rows events
+   * of other tables are dropped after reading their table id, before any
+   * row image is copied.
+   *
+   * Set the filter before connecting; the driver may read it from another
+   * thread.
+   */
+  void set_table_filter(const Table_filter &filter);
+  const Table_filter &table_filter() const { return m_table_filter; }
+
+  /**
+   * True if the rows event with the table id stored at the start of body
+   * belongs to a table which the table filter excludes. The table ids of
+   * tables whose table map wasn't seen are not excluded.
+   *
+   * Every rows event must be passed here, as the excluded table ids are
+   * forgotten at the end of a statement once there are too many.
+   *
+   * @param body The event body, after the common header; at least the
+   *        table id and the flags
+   * @param size The number of bytes available at body
+   */
+  bool is_excluded_rows_event(unsigned char type_code, const char *body,
+                              size_t size)
+  {
+    if (m_excluded_tables.empty() || size < 8 ||
+        (type_code != WRITE_ROWS_EVENT && type_code != UPDATE_ROWS_EVENT &&
+         type_code != DELETE_ROWS_EVENT))
+      return false;
+    const unsigned char *head= (const unsigned char *) body;
+    uint64_t table_id= Int_reader<6>::load(head);
+    bool excluded= m_excluded_tables.count(table_id) != 0;
+    if (m_evict_excluded && (Int_reader<2>::load(head + 6) & ROWS_STMT_END_F))
+    {
+      m_excluded_tables.clear();
+      m_evict_excluded= false;
+    }
+    return excluded;
+  }
+
+  /**
+   * Decode the body of an event. The decoder must be positioned at the
+   * first byte after the common event header.
+   *
+   * @return A new event, or 0 if the event type isn't subscribed or the
+   *         event belongs to a table which the table filter excludes. A
+   *         truncated event is returned as an incident event.
+   */
+  Binary_log_event* parse_event(Buffer_decoder &dec, Log_event_header *header);
 
 protected:
+  /**
+   * Give a table map event the cached decode plan of its table, or cache a
+   * new one if the table is new or its columns changed.
+   */
+  void attach_decode_plan(Table_map_event *table_map);
+
+  /**
+   * Apply the table filter to a table map event and remember the result
+   * for the rows events of the table.
+   *
+   * @return True if the table is allowed
+   */
+  bool filter_table_map(const Table_map_event *table_map);
+
   /**
    * Used each time the client reconnects to the server to specify an
    * offset position.
    */
   unsigned long m_binlog_offset;
   std::string m_binlog_file_name;
+
+private:
+  Event_type_mask m_event_mask;
+
+  /**
+   * Recycles the events returned by parse_event(). It lives on after the
+   * driver until all its events are released.
+   */
+  Event_pool *m_event_pool;
+
+  Table_filter m_table_filter;
+  /**
+   * The ids of the tables which the table filter excludes, from the table
+   * map events seen so far.
+   */
+  std::set<uint64_t> m_excluded_tables;
+  /**
+   * True if m_excluded_tables is full and is to be cleared at the end of
+   * the current statement, once no rows event refers to its table maps.
+   */
+  bool m_evict_excluded;
+
+  typedef std::map<uint64_t, Decode_plan *> Decode_plan_cache;
+  /**
+   * Decode plans by table id. Plans are shared with the table map events
+   * which use them.
+   */
+  Decode_plan_cache m_decode_plans;
 };
 
 } // namespace mysql::system
@@ -20,10 +20,12 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 #ifndef _BINLOG_EVENT_H
 #define	_BINLOG_EVENT_H
 
+#include <bitset>
 #include <list>
 #include <stdint.h>
 #include <vector>
 #include <string>
+#include "event_buffer.h"
 
 namespace mysql
 {
@@ -89,6 +91,14 @@ enum Log_event_type
            * A user defined event
            */
           USER_DEFINED= 27,
+
+  /*
+    Transaction boundaries made by Basic_transaction_parser in streaming
+    mode. They are numbered well above the events of the server.
+  */
+  TRANSACTION_BEGIN_EVENT= 200,
+  TRANSACTION_COMMIT_EVENT= 201,
+
   /*
     Add new events here - right above this comment!
     Existing events (except ENUM_END_EVENT) should never change their numbers
@@ -103,6 +113,11 @@ namespace system {
  * Convenience function to get the string representation of a binlog event.
  */
 const char* get_event_type_str(Log_event_type type);
+
+/**
+ * A set of event types, one bit per Log_event_type.
+ */
+typedef std::bitset<256> Event_type_mask;
 } // end namespace system
 
 #define LOG_EVENT_HEADER_SIZE 20
@@ -120,6 +135,7 @@ public:
 
 
 class Binary_log_event;
+class Event_pool;
 
 /**
  * TODO Base class for events. Implementation is in body()
@@ -127,7 +143,7 @@ class Binary_log_event;
 class Binary_log_event
 {
 public:
-    Binary_log_event()
+    Binary_log_event() : m_pool(0)
     {
         /*
           An event length of 0 indicates that the header isn't initialized
@@ -136,7 +152,7 @@ public:
         m_header.type_code=    0;
     }
 
-    Binary_log_event(Log_event_header *header)
+    Binary_log_event(Log_event_header *header) : m_pool(0)
     {
         m_header= *header;
     }
@@ -156,8 +172,16 @@ public:
      */
     Log_event_header *header() { return &m_header; }
 
+    /**
+     * The pool the event was taken from, or 0. See release_event().
+     */
+    Event_pool *pool() const { return m_pool; }
+
 private:
+    friend class Event_pool;
+
     Log_event_header m_header;
+    Event_pool *m_pool;
 };
 
 class Query_event: public Binary_log_event
@@ -211,10 +235,14 @@ public:
     std::string value; /* encoded in binary speak, depends on .type */
 };
 
+class Decode_plan;
+
 class Table_map_event: public Binary_log_event
 {
 public:
-    Table_map_event(Log_event_header *header) : Binary_log_event(header) {}
+    Table_map_event(Log_event_header *header)
+      : Binary_log_event(header), decode_plan(0), transaction_seq_no(0) {}
+    ~Table_map_event();
     uint64_t table_id;
     uint16_t flags;
     std::string db_name;
@@ -222,19 +250,39 @@ public:
     std::vector<uint8_t> columns;
     std::vector<uint8_t> metadata;
     std::vector<uint8_t> null_bits;
+    /**
+     * How to decode the rows of the table. Attached by the driver from its
+     * per-table cache or built on first use by get_decode_plan().
+     */
+    Decode_plan *decode_plan;
+    /**
+     * The sequence number of the transaction of the event when it was
+     * streamed by a Basic_transaction_parser, otherwise 0.
+     */
+    uint64_t transaction_seq_no;
 };
 
 class Row_event: public Binary_log_event
 {
 public:
-    Row_event(Log_event_header *header) : Binary_log_event(header) {}
+    Row_event(Log_event_header *header)
+      : Binary_log_event(header), transaction_seq_no(0) {}
     uint64_t table_id;
     uint16_t flags;
     uint64_t columns_len;
     uint32_t null_bits_len;
     std::vector<uint8_t> columns_before_image;
     std::vector<uint8_t> used_columns;
-    std::vector<uint8_t> row;
+    /**
+     * The row images. When the event was read from a driver receive buffer
+     * this refers directly into that buffer.
+     */
+    Event_payload row;
+    /**
+     * The sequence number of the transaction of the event when it was
+     * streamed by a Basic_transaction_parser, otherwise 0.
+     */
+    uint64_t transaction_seq_no;
 };
 
 class Int_var_event: public Binary_log_event
@@ -263,6 +311,12 @@ public:
 
 Binary_log_event *create_incident_event(unsigned int type, const char *message, unsigned long pos= 0);
 
+/**
+ * Create a rotate event like the one a server sends when the stream goes
+ * on in another file. It has no next position, as it isn't in a file.
+ */
+Binary_log_event *create_rotate_event(const std::string &file, unsigned long pos);
+
 } // end namespace mysql
 
 #endif	/* _BINLOG_EVENT_H */
@@ -0,0 +1,198 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _BUFFER_DECODER_H
+#define	_BUFFER_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "event_buffer.h"
+#include "int_reader.h"
+
+namespace mysql {
+namespace system {
+
+/**
+ * Decodes the little-endian fields of a binlog event from a block of
+ * memory. Every read is checked against the end of the block; a read
+ * which doesn't fit sets the overrun flag, leaves the target zeroed or
+ * empty and makes all following reads fail too. The caller checks
+ * overrun() once after decoding a whole event.
+ *
+ * Example:
+ *   Buffer_decoder dec(packet, packet_length);
+ *   dec.read(ev->thread_id)
+ *      .read(ev->exec_time);
+ *   if (dec.overrun())
+ *     ...
+ */
+class Buffer_decoder
+{
+public:
+  /**
+   * @param data The first byte to decode
+   * @param size The number of bytes which can be decoded
+   * @param owner If not 0, the buffer which holds data. Payloads read with
+   *              read_payload() will then refer to it instead of being
+   *              copied.
+   */
+  Buffer_decoder(const char *data, size_t size, Event_buffer *owner= 0)
+    : m_ptr((const uint8_t *)data), m_end((const uint8_t *)data + size),
+      m_owner(owner), m_overrun(false)
+  {
+  }
+
+  const char *current() const { return (const char *)m_ptr; }
+  size_t remaining() const { return m_end - m_ptr; }
+  bool overrun() const { return m_overrun; }
+  Event_buffer *owner() const { return m_owner; }
+
+  /**
+   * Read a fixed width integer of sizeof(T) bytes.
+   */
+  template <typename T>
+  Buffer_decoder &read(T &value)
+  {
+    if (!reserve(sizeof(T)))
+    {
+      value= 0;
+      return *this;
+    }
+    value= (T) Int_reader<sizeof(T)>::load(m_ptr);
+    m_ptr+= sizeof(T);
+    return *this;
+  }
+
+  /**
+   * Read an unsigned integer stored in the first N bytes.
+   */
+  template <int N, typename T>
+  Buffer_decoder &read_int(T &value)
+  {
+    if (!reserve(N))
+    {
+      value= 0;
+      return *this;
+    }
+    value= (T) Int_reader<N>::load(m_ptr);
+    m_ptr+= N;
+    return *this;
+  }
+
+  /**
+   * Read a length encoded binary. The value of a NULL marker is 251.
+   */
+  Buffer_decoder &read_length_encoded(uint64_t &value)
+  {
+    if (!reserve(1) ||
+        !reserve(1 + Length_encoded_reader::extra_bytes(*m_ptr)))
+    {
+      value= 0;
+      return *this;
+    }
+    value= Length_encoded_reader::load(m_ptr);
+    m_ptr+= 1 + Length_encoded_reader::extra_bytes(*m_ptr);
+    return *this;
+  }
+
+  Buffer_decoder &read_string(std::string &str, size_t length)
+  {
+    if (!reserve(length))
+    {
+      str.clear();
+      return *this;
+    }
+    str.assign((const char *)m_ptr, length);
+    m_ptr+= length;
+    return *this;
+  }
+
+  /**
+   * Read a string which is preceded by a one byte length.
+   */
+  Buffer_decoder &read_string_len(std::string &str)
+  {
+    uint8_t length;
+    read(length);
+    return read_string(str, length);
+  }
+
+  Buffer_decoder &read_bytes(std::vector<uint8_t> &vec, size_t length)
+  {
+    if (!reserve(length))
+    {
+      vec.clear();
+      return *this;
+    }
+    vec.assign(m_ptr, m_ptr + length);
+    m_ptr+= length;
+    return *this;
+  }
+
+  /**
+   * Read length bytes into a payload which shares the owner buffer if
+   * there is one.
+   */
+  Buffer_decoder &read_payload(Event_payload &payload, size_t length)
+  {
+    if (!reserve(length))
+    {
+      payload.clear();
+      return *this;
+    }
+    if (m_owner)
+      payload.assign((const char *)m_ptr, length, m_owner);
+    else
+      payload.assign((const char *)m_ptr, length);
+    m_ptr+= length;
+    return *this;
+  }
+
+  Buffer_decoder &skip(size_t length)
+  {
+    if (reserve(length))
+      m_ptr+= length;
+    return *this;
+  }
+
+private:
+  bool reserve(size_t length)
+  {
+    if (!m_overrun && length <= (size_t)(m_end - m_ptr))
+      return true;
+    m_overrun= true;
+    m_ptr= m_end;
+    return false;
+  }
+
+  const uint8_t *m_ptr;
+  const uint8_t *m_end;
+  Event_buffer *m_owner;
+  bool m_overrun;
+};
+
+} // end namespace system
+} // end namespace mysql
+
+#endif	/* _BUFFER_DECODER_H */
@@ -0,0 +1,204 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _COLUMN_BATCH_H
+#define	_COLUMN_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "binlog_event.h"
+#include "decode_plan.h"
+
+namespace mysql {
+
+/**
+ * The storage of a decoded column.
+ */
+enum Column_vector_type
+{
+  /**
+    Integer types, ENUM, SET, YEAR, DATE, TIME, TIMESTAMP and DATETIME in
+    their binlog encoding
+  */
+  COLUMN_INT64,
+  /** FLOAT and DOUBLE */
+  COLUMN_DOUBLE,
+  /**
+    Strings and blobs without their length prefix, and the raw bytes of
+    every other type
+  */
+  COLUMN_BINARY
+};
+
+/**
+ * The values of one column for a batch of rows, laid out the way Arrow
+ * lays out a column: a contiguous array of int64_t or double values, or
+ * an offsets array plus a data buffer for variable length values. Value
+ * i of a binary column is data()[offsets()[i]] up to offsets()[i + 1].
+ *
+ * Validity is a bitmap with one bit per row, least significant bit first;
+ * a set bit means the value is not NULL. A NULL value is stored as 0 or
+ * as an empty string.
+ */
+class Column_vector
+{
+public:
+  explicit Column_vector(Column_vector_type type= COLUMN_BINARY)
+    : m_type(type), m_size(0), m_null_count(0), m_offsets(1, 0)
+  {
+  }
+
+  Column_vector_type type() const { return m_type; }
+  size_t size() const { return m_size; }
+  size_t null_count() const { return m_null_count; }
+
+  const std::vector<int64_t> &int64_values() const { return m_int64; }
+  const std::vector<double> &double_values() const { return m_double; }
+  const std::vector<uint32_t> &offsets() const { return m_offsets; }
+  const std::vector<char> &data() const { return m_data; }
+  const std::vector<uint8_t> &validity() const { return m_validity; }
+
+  bool is_valid(size_t row) const
+  {
+    return (m_validity[row / 8] & (1 << (row & 7))) != 0;
+  }
+
+  /**
+   * Value row of a binary column.
+   */
+  const char *binary_value(size_t row, size_t &length) const
+  {
+    length= m_offsets[row + 1] - m_offsets[row];
+    return m_data.empty() ? 0 : &m_data[0] + m_offsets[row];
+  }
+
+  void clear();
+
+private:
+  friend class Column_batch;
+
+  void append_validity(bool valid)
+  {
+    if ((m_size & 7) == 0)
+      m_validity.push_back(0);
+    if (valid)
+      m_validity.back()|= 1 << (m_size & 7);
+    else
+      ++m_null_count;
+    ++m_size;
+  }
+
+  void append_null()
+  {
+    switch (m_type)
+    {
+    case COLUMN_INT64:  m_int64.push_back(0); break;
+    case COLUMN_DOUBLE: m_double.push_back(0); break;
+    case COLUMN_BINARY: m_offsets.push_back(m_data.size()); break;
+    }
+    append_validity(false);
+  }
+
+  void append_binary(const unsigned char *value, size_t length)
+  {
+    m_data.insert(m_data.end(), value, value + length);
+    m_offsets.push_back(m_data.size());
+    append_validity(true);
+  }
+
+  Column_vector_type m_type;
+  size_t m_size;
+  size_t m_null_count;
+  std::vector<int64_t> m_int64;
+  std::vector<double> m_double;
+  std::vector<uint32_t> m_offsets;
+  std::vector<char> m_data;
+  std::vector<uint8_t> m_validity;
+};
+
+/**
+ * Decodes the rows of one or more rows events for the same table straight
+ * into one Column_vector per column, without creating a Value per field.
+ *
+ * Example:
+ *   Column_batch batch(table_map);
+ *   batch.append(rows_event);
+ *   const Column_vector &id= batch.column(0);
+ *   for (size_t i= 0; i < batch.row_count(); ++i)
+ *     if (id.is_valid(i))
+ *       sum+= id.int64_values()[i];
+ */
+class Column_batch
+{
+public:
+  /**
+   * Which image of an updated row to decode. Inserts only have an after
+   * image and deletes only a before image; CURRENT_IMAGE picks the after
+   * image if there is one.
+   */
+  enum Image
+  {
+    CURRENT_IMAGE,
+    BEFORE_IMAGE
+  };
+
+  explicit Column_batch(const Table_map_event *table_map);
+  ~Column_batch();
+
+  /**
+   * Decode all rows of a rows event and append them to the columns.
+   * Events without the requested image, such as inserts for BEFORE_IMAGE,
+   * add no rows.
+   *
+   * @retval 0 Success
+   * @retval 1 The event belongs to another table
+   */
+  int append(const Row_event *row_event, Image image= CURRENT_IMAGE);
+
+  size_t row_count() const { return m_row_count; }
+  size_t column_count() const { return m_columns.size(); }
+  const Column_vector &column(size_t col_no) const { return m_columns[col_no]; }
+
+  /**
+   * Remove all rows; the buffers keep their capacity for the next batch.
+   */
+  void clear();
+
+private:
+  Column_batch(const Column_batch&);              // Disabled copy constructor
+  Column_batch& operator = (const Column_batch&); // Disabled assign operator
+
+  size_t append_row(const unsigned char *row, size_t offset,
+                    size_t null_bits_len);
+
+  /** A reference is held so that the batch may outlive the table map */
+  Decode_plan *m_plan;
+  uint64_t m_table_id;
+  size_t m_row_count;
+  /** How each column is decoded, a value of the local enum Cell_decoder */
+  std::vector<uint8_t> m_decoders;
+  std::vector<Column_vector> m_columns;
+};
+
+} // end namespace mysql
+
+#endif	/* _COLUMN_BATCH_H */
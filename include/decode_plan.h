@@ -0,0 +1,229 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _DECODE_PLAN_H
+#define	_DECODE_PLAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "ref_counted.h"
+#include "int_reader.h"
+#include "value.h"
+
+namespace mysql {
+
+class Table_map_event;
+
+/**
+ * How the size of a field in a row image is found.
+ */
+enum Column_size_kind
+{
+  /** The field always has the same size */
+  FIXED_SIZE,
+  /**
+    The field starts with a little-endian length of prefix_width bytes
+    which doesn't include the prefix itself
+  */
+  LENGTH_PREFIXED
+};
+
+/**
+ * Everything needed to step over or decode one column of a row image.
+ */
+struct Column_plan
+{
+  uint8_t type;                                 // enum_field_types
+  uint8_t size_kind;                            // Column_size_kind
+  uint8_t prefix_width;
+  uint32_t fixed_size;
+  uint32_t metadata;
+};
+
+/**
+ * The columns of a table which a consumer wants decoded. An empty
+ * projection selects all columns.
+ *
+ * Example:
+ *   Column_projection projection;
+ *   projection.add(0);
+ *   projection.add(7);
+ *   rows.set_projection(projection);
+ */
+class Column_projection
+{
+public:
+  Column_projection() {}
+
+  /**
+   * Select the columns whose entry in mask is true.
+   */
+  explicit Column_projection(const std::vector<bool> &mask) : m_mask(mask) {}
+
+  void add(size_t col_no)
+  {
+    if (col_no >= m_mask.size())
+      m_mask.resize(col_no + 1, false);
+    m_mask[col_no]= true;
+  }
+
+  bool empty() const { return m_mask.empty(); }
+  bool contains(size_t col_no) const
+  {
+    return col_no < m_mask.size() && m_mask[col_no];
+  }
+
+private:
+  std::vector<bool> m_mask;
+};
+
+/**
+ * The column layout of a table as given by a Table_map_event, worked out
+ * once so that rows can be decoded without looking at the column types
+ * and metadata again. A plan is immutable after construction and shared
+ * by all table map events of the table which describe the same columns.
+ */
+class Decode_plan : public Ref_counted
+{
+public:
+  explicit Decode_plan(const Table_map_event *table_map);
+
+  /**
+   * True if the table map describes the same columns as the plan.
+   */
+  bool matches(const Table_map_event *table_map) const;
+
+  size_t column_count() const { return m_columns.size(); }
+  const Column_plan &column(size_t col_no) const { return m_columns[col_no]; }
+
+  /**
+   * True if every column has a fixed size. A row without NULL values then
+   * has row_fixed_size() bytes after the null bits.
+   */
+  bool all_fixed() const { return m_all_fixed; }
+  size_t row_fixed_size() const { return m_row_fixed_size; }
+
+  /**
+   * The size in bytes of the field of column col_no starting at field.
+   */
+  uint32_t field_size(size_t col_no, const unsigned char *field) const
+  {
+    const Column_plan &col= m_columns[col_no];
+    if (col.size_kind == FIXED_SIZE)
+      return col.fixed_size;
+    switch (col.prefix_width)
+    {
+    case 1: return 1 + system::Int_reader<1>::load(field);
+    case 2: return 2 + system::Int_reader<2>::load(field);
+    case 3: return 3 + system::Int_reader<3>::load(field);
+    default: return 4 + system::Int_reader<4>::load(field);
+    }
+  }
+
+  /**
+   * Step over one row image.
+   *
+   * @param row The row images of a rows event
+   * @param offset The offset of the null bits of the row image
+   * @param null_bits_len The size of the null bits
+   *
+   * @return The offset of the next row image
+   */
+  size_t skip_row(const unsigned char *row, size_t offset,
+                  size_t null_bits_len) const;
+
+  /**
+   * Decode one row image into a container of Values, such as
+   * Row_of_fields. Arguments are the same as for skip_row().
+   *
+   * @return The offset of the next row image
+   */
+  template <class Fields>
+  size_t decode_row(const unsigned char *row, size_t offset,
+                    size_t null_bits_len, Fields &fields) const
+  {
+    return decode_row(row, offset, null_bits_len, 0, fields);
+  }
+
+  /**
+   * Decode only the columns in projection, in column order. The other
+   * columns are stepped over by their size alone. A projection of 0 or
+   * an empty projection decodes all columns.
+   */
+  template <class Fields>
+  size_t decode_row(const unsigned char *row, size_t offset,
+                    size_t null_bits_len, const Column_projection *projection,
+                    Fields &fields) const
+  {
+    if (projection && projection->empty())
+      projection= 0;
+    const unsigned char *null_bits= row + offset;
+    size_t count= m_columns.size();
+    offset+= null_bits_len;
+    if (!projection)
+      fields.reserve(fields.size() + count);
+    for (size_t col_no= 0; col_no < count; ++col_no)
+    {
+      const Column_plan &col= m_columns[col_no];
+      const char *storage= (const char *)row + offset;
+      bool is_null= (null_bits[col_no / 8] & (1 << (col_no & 7))) != 0;
+      if (projection && !projection->contains(col_no))
+      {
+        if (!is_null)
+          offset+= field_size(col_no, row + offset);
+        continue;
+      }
+      /*
+        A NULL value isn't stored in the row image and doesn't advance the
+        offset.
+      */
+      if (is_null)
+      {
+        fields.push_back(Value((system::enum_field_types) col.type,
+                               col.metadata, storage, 0, true));
+        continue;
+      }
+      uint32_t size= field_size(col_no, row + offset);
+      fields.push_back(Value((system::enum_field_types) col.type,
+                             col.metadata, storage, size, false));
+      offset+= size;
+    }
+    return offset;
+  }
+
+private:
+  std::vector<Column_plan> m_columns;
+  std::vector<uint8_t> m_types;
+  std::vector<uint8_t> m_metadata;
+  bool m_all_fixed;
+  size_t m_row_fixed_size;
+};
+
+/**
+ * Get the decode plan of a table map event, building it the first time
+ * if the driver didn't attach one. The plan belongs to the event.
+ */
+const Decode_plan *get_decode_plan(const Table_map_event *table_map);
+
+} // end namespace mysql
+
+#endif	/* _DECODE_PLAN_H */
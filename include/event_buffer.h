@@ -0,0 +1,162 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _EVENT_BUFFER_H
+#define	_EVENT_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <vector>
+
+#include "ref_counted.h"
+
+namespace mysql {
+
+class Event_buffer_pool;
+
+/**
+ * A reference counted block of memory which parsed events can point into
+ * instead of copying their payload. Buffers taken from an
+ * Event_buffer_pool go back to the pool when the last reference is
+ * released; other buffers are freed.
+ */
+class Event_buffer : public Ref_counted
+{
+public:
+  explicit Event_buffer(size_t capacity);
+
+  char *data() { return m_data; }
+  const char *data() const { return m_data; }
+  size_t capacity() const { return m_capacity; }
+
+  /**
+   * True if the buffer allocated its memory itself, false if it refers to
+   * memory such as a mapped file.
+   */
+  bool owns_data() const { return m_owns_data; }
+
+protected:
+  /**
+   * Refer to memory which the derived class owns and frees, such as a
+   * mapped file.
+   */
+  Event_buffer(char *data, size_t capacity);
+
+  ~Event_buffer();
+  void destroy();
+
+private:
+  friend class Event_buffer_pool;
+
+  char *m_data;
+  size_t m_capacity;
+  Event_buffer_pool *m_pool;
+  bool m_owns_data;
+};
+
+/**
+ * A free list of equally sized Event_buffer objects. The pool stays alive
+ * as long as any of its buffers are in use, so events may outlive the
+ * driver which created them. get() and the return of a buffer may happen
+ * in different threads.
+ */
+class Event_buffer_pool : public Ref_counted
+{
+public:
+  /**
+   * @param buffer_size The capacity of every buffer in the pool
+   * @param max_free The number of unused buffers kept for reuse
+   */
+  Event_buffer_pool(size_t buffer_size, size_t max_free);
+
+  /**
+   * Get an unused buffer. The caller owns the single reference.
+   */
+  Event_buffer *get();
+
+  size_t buffer_size() const { return m_buffer_size; }
+
+protected:
+  ~Event_buffer_pool();
+
+private:
+  friend class Event_buffer;
+  void put(Event_buffer *buffer);
+
+  size_t m_buffer_size;
+  size_t m_max_free;
+  std::vector<Event_buffer *> m_free;
+  pthread_mutex_t m_mutex;
+};
+
+/**
+ * A read-only range of bytes belonging to an event. The bytes live in an
+ * Event_buffer which is either shared with other events (typically the
+ * receive buffer of a driver) or private to this payload. Copies share the
+ * same buffer.
+ *
+ * The interface mirrors the parts of std::vector<uint8_t> which are used
+ * for reading.
+ */
+class Event_payload
+{
+public:
+  typedef const uint8_t *const_iterator;
+  typedef const_iterator iterator;
+  typedef size_t size_type;
+
+  Event_payload() : m_data(0), m_size(0), m_buffer(0) {}
+  Event_payload(const Event_payload &other);
+  Event_payload &operator=(const Event_payload &other);
+  ~Event_payload() { clear(); }
+
+  /**
+   * Refer to size bytes at data inside buffer. A new reference to the
+   * buffer is taken.
+   */
+  void assign(const char *data, size_t size, Event_buffer *buffer);
+
+  /**
+   * Copy size bytes from data into a private buffer.
+   */
+  void assign(const char *data, size_t size);
+
+  void clear();
+
+  const uint8_t *data() const { return m_data; }
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  const uint8_t &operator[](size_t index) const { return m_data[index]; }
+  const_iterator begin() const { return m_data; }
+  const_iterator end() const { return m_data + m_size; }
+
+  /** The buffer the bytes live in, or 0 if the payload is empty */
+  const Event_buffer *buffer() const { return m_buffer; }
+
+private:
+  const uint8_t *m_data;
+  size_t m_size;
+  Event_buffer *m_buffer;
+};
+
+} // end namespace mysql
+
+#endif	/* _EVENT_BUFFER_H */
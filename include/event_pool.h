@@ -0,0 +1,140 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _EVENT_POOL_H
+#define	_EVENT_POOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <vector>
+
+#include "ref_counted.h"
+#include "binlog_event.h"
+
+/* The number of unused events of each type kept by a driver */
+#define EVENT_POOL_SIZE 64
+
+namespace mysql {
+
+/**
+ * A free list of parsed events which recycles the event objects together
+ * with the capacity of their strings and vectors. There is one list per
+ * event type code, as the drivers always create the same class for the
+ * same type code.
+ *
+ * An event taken from the pool goes back to it through release_event().
+ * Deleting it is also allowed; it is then freed instead of recycled. The
+ * pool stays alive as long as any of its events are in use, and events
+ * may be returned from another thread than the one which took them.
+ */
+class Event_pool : public Ref_counted
+{
+public:
+  /**
+   * @param max_free The number of unused events of each type code kept
+   *                 for reuse
+   */
+  explicit Event_pool(size_t max_free= EVENT_POOL_SIZE);
+
+  /**
+   * Get an event of class T with a copy of header. A recycled event keeps
+   * the values of its other members, which the caller must overwrite.
+   */
+  template <class T>
+  T *get(Log_event_header *header)
+  {
+    Binary_log_event *event= 0;
+    std::vector<Binary_log_event *> &free_list= m_free[header->type_code];
+    pthread_mutex_lock(&m_mutex);
+    if (!free_list.empty())
+    {
+      event= free_list.back();
+      free_list.pop_back();
+    }
+    pthread_mutex_unlock(&m_mutex);
+
+    /* Every event handed out keeps the pool alive */
+    add_ref();
+    if (event == 0)
+    {
+      T *new_event= new T(header);
+      new_event->m_pool= this;
+      return new_event;
+    }
+    *event->header()= *header;
+    return static_cast<T *>(event);
+  }
+
+  /**
+   * Return an event taken from this pool.
+   */
+  void put(Binary_log_event *event) { put(&event, 1); }
+
+  /**
+   * Return count events taken from this pool, with one lock of the free
+   * lists and one release of the references they hold to the pool. The
+   * pointers in events are overwritten.
+   */
+  void put(Binary_log_event **events, size_t count);
+
+protected:
+  ~Event_pool();
+
+private:
+  size_t m_max_free;
+  pthread_mutex_t m_mutex;
+  std::vector<Binary_log_event *> m_free[256];
+};
+
+/**
+ * Create an event of class T, taken from pool unless pool is 0.
+ */
+template <class T>
+T *create_event(Event_pool *pool, Log_event_header *header)
+{
+  if (pool)
+    return pool->get<T>(header);
+  return new T(header);
+}
+
+/**
+ * Dispose of an event: return it to the pool it was taken from, or delete
+ * it if it wasn't taken from a pool.
+ */
+inline void release_event(Binary_log_event *event)
+{
+  if (event == 0)
+    return;
+  if (event->pool())
+    event->pool()->put(event);
+  else
+    delete event;
+}
+
+/**
+ * Dispose of count events as release_event() does, returning the events
+ * which were taken from the same pool in runs. The pointers in events are
+ * overwritten.
+ */
+void release_events(Binary_log_event **events, size_t count);
+
+} // end namespace mysql
+
+#endif	/* _EVENT_POOL_H */
@@ -25,6 +25,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 #include "binlog_event.h"
 #include "value.h"
 #include "row_of_fields.h"
+#include "decode_plan.h"
 
 using namespace mysql;
 
@@ -40,14 +41,19 @@ class Row_event_iterator : public std::iterator<std::forward_iterator_tag,
                                                 Iterator_value_type>
 {
 public:
-  Row_event_iterator() : m_row_event(0), m_table_map(0),
+  Row_event_iterator() : m_row_event(0), m_table_map(0), m_projection(0),
                          m_new_field_offset_calculated(0), m_field_offset(0)
   { }
 
+  /**
+   * @param projection If not 0, only these columns are returned by
+   *                   operator*. It must outlive the iterator.
+   */
   Row_event_iterator(const Row_event *row_event,
-                     const Table_map_event *table_map)
+                     const Table_map_event *table_map,
+                     const Column_projection *projection= 0)
     : m_row_event(row_event), m_table_map(table_map),
-      m_new_field_offset_calculated(0)
+      m_projection(projection), m_new_field_offset_calculated(0)
   {
       m_field_offset= 0;
   }
@@ -67,6 +73,7 @@ private:
     size_t fields(Iterator_value_type& fields_vector );
     const Row_event *m_row_event;
     const Table_map_event *m_table_map;
+    const Column_projection *m_projection;
     unsigned long m_new_field_offset_calculated;
     unsigned long m_field_offset;
 };
@@ -76,37 +83,9 @@ private:
 template <class Iterator_value_type>
 size_t Row_event_iterator<Iterator_value_type>::fields(Iterator_value_type& fields_vector )
 {
-  size_t field_offset= m_field_offset;
-  int row_field_col_index= 0;
-  std::vector<uint8_t> nullbits(m_row_event->null_bits_len);
-  std::copy(m_row_event->row.begin()+m_field_offset,
-            m_row_event->row.begin()+(m_field_offset+m_row_event->null_bits_len),
-            nullbits.begin());
-
-  field_offset += m_row_event->null_bits_len;
-  for(unsigned col_no=0; col_no < m_table_map->columns.size(); ++col_no)
-  {
-    ++row_field_col_index;
-    unsigned int type= m_table_map->columns[col_no]&0xFF;
-    uint32_t metadata= extract_metadata(m_table_map, col_no);
-    mysql::Value val((enum mysql::system::enum_field_types)type,
-                     metadata,
-                     (const char *)&m_row_event->row[field_offset]);
-    if (is_null((unsigned char *)&nullbits[0], col_no ))
-    {
-      val.is_null(true);
-    }
-    else
-    {
-       /*
-        If the value is null it is not in the list of values and thus we won't
-        increse the offset. TODO what if all values are null?!
-       */
-      field_offset += val.length();
-    }
-    fields_vector.push_back(val);
-  }
-  return field_offset;
+  return get_decode_plan(m_table_map)->
+    decode_row(m_row_event->row.data(), m_field_offset,
+               m_row_event->null_bits_len, m_projection, fields_vector);
 }
 
 template <class Iterator_value_type >
@@ -134,34 +113,19 @@ Row_event_iterator< Iterator_value_type >&
     if (m_new_field_offset_calculated != 0)
     {
       m_field_offset= m_new_field_offset_calculated;
-      //m_field_offset += m_row_event->null_bits_len;
       m_new_field_offset_calculated= 0;
-      if (m_field_offset >= m_row_event->row.size())
-        m_field_offset= 0;
-      return *this;
     }
-
-    /*
-     * Advance the field offset to the next row
-     */
-    int row_field_col_index= 0;
-    std::vector<uint8_t> nullbits(m_row_event->null_bits_len);
-    std::copy(m_row_event->row.begin()+m_field_offset,
-              m_row_event->row.begin()+(m_field_offset+m_row_event->null_bits_len),
-              nullbits.begin());
-    m_field_offset += m_row_event->null_bits_len;
-    for(unsigned col_no=0; col_no < m_table_map->columns.size(); ++col_no)
+    else
     {
-      ++row_field_col_index;
-      mysql::Value val((enum mysql::system::enum_field_types)m_table_map->columns[col_no],
-                       m_table_map->metadata[col_no],
-                       (const char *)&m_row_event->row[m_field_offset]);
-      if (!is_null((unsigned char *)&nullbits[0], col_no))
-      {
-        m_field_offset += val.length();
-      }
+      /*
+       * Advance the field offset to the next row
+       */
+      m_field_offset= get_decode_plan(m_table_map)->
+        skip_row(m_row_event->row.data(), m_field_offset,
+                 m_row_event->null_bits_len);
     }
-
+    if (m_field_offset >= m_row_event->row.size())
+      m_field_offset= 0;
     return *this;
   }
 
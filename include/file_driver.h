@@ -32,6 +32,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 #include "protocol.h"
 
 #define MAGIC_NUMBER_SIZE 4
+#define FILE_BUFFER_SIZE (64 * 1024)
 
 namespace mysql {
 namespace system {
@@ -43,10 +44,17 @@ public:
   template <class TFilename>
   Binlog_file_driver(const TFilename& filename = TFilename(),
                      unsigned int offset = 0)
-    : Binary_log_driver(filename, offset)
+    : Binary_log_driver(filename, offset), m_event_buffer(0),
+      m_event_buffer_used(0)
   {
   }
 
+  ~Binlog_file_driver()
+  {
+    if (m_event_buffer)
+      m_event_buffer->release();
+  }
+
     int connect();
     int disconnect();
     int wait_for_next_event(mysql::Binary_log_event **event);
@@ -66,6 +74,14 @@ private:
     std::ifstream m_binlog_file;
 
     Log_event_header m_event_log_header;
+
+    /*
+      Holds the bodies of the last events read. Row events refer into it.
+    */
+    Event_buffer *m_event_buffer;
+
+    /* The bytes of m_event_buffer taken by bodies */
+    size_t m_event_buffer_used;
 };
 
 } // namespace mysql::system
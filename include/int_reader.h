@@ -0,0 +1,143 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _INT_READER_H
+#define	_INT_READER_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define LE_TO_HOST16(A) __builtin_bswap16(A)
+#define LE_TO_HOST32(A) __builtin_bswap32(A)
+#define LE_TO_HOST64(A) __builtin_bswap64(A)
+#else
+#define LE_TO_HOST16(A) (A)
+#define LE_TO_HOST32(A) (A)
+#define LE_TO_HOST64(A) (A)
+#endif
+
+namespace mysql {
+namespace system {
+
+/**
+ * Reads an N byte little-endian unsigned integer from unaligned memory.
+ * Only the widths used by the binlog format are defined; each compiles
+ * to one or two plain loads.
+ *
+ * Example:
+ *   uint64_t table_id= Int_reader<6>::load(ptr);
+ */
+template <int N> struct Int_reader;
+
+template <> struct Int_reader<1>
+{
+  typedef uint8_t type;
+  static type load(const unsigned char *p) { return p[0]; }
+};
+
+template <> struct Int_reader<2>
+{
+  typedef uint16_t type;
+  static type load(const unsigned char *p)
+  {
+    uint16_t value;
+    memcpy(&value, p, 2);
+    return LE_TO_HOST16(value);
+  }
+};
+
+template <> struct Int_reader<3>
+{
+  typedef uint32_t type;
+  static type load(const unsigned char *p)
+  {
+    return (uint32_t) Int_reader<2>::load(p) | ((uint32_t) p[2] << 16);
+  }
+};
+
+template <> struct Int_reader<4>
+{
+  typedef uint32_t type;
+  static type load(const unsigned char *p)
+  {
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return LE_TO_HOST32(value);
+  }
+};
+
+template <> struct Int_reader<6>
+{
+  typedef uint64_t type;
+  static type load(const unsigned char *p)
+  {
+    return (uint64_t) Int_reader<4>::load(p) |
+           ((uint64_t) Int_reader<2>::load(p + 4) << 32);
+  }
+};
+
+template <> struct Int_reader<8>
+{
+  typedef uint64_t type;
+  static type load(const unsigned char *p)
+  {
+    uint64_t value;
+    memcpy(&value, p, 8);
+    return LE_TO_HOST64(value);
+  }
+};
+
+/**
+ * Reads a length encoded binary. The first byte is either the value
+ * itself or tells how many bytes follow: 252 two, 253 three and 254
+ * eight. 251 is the NULL marker and is returned as the value.
+ */
+struct Length_encoded_reader
+{
+  /** The number of bytes which follow the first byte */
+  static unsigned int extra_bytes(unsigned char first)
+  {
+    switch (first)
+    {
+    case 252: return 2;
+    case 253: return 3;
+    case 254: return 8;
+    default:  return 0;
+    }
+  }
+
+  /** p points at the first byte; extra_bytes(*p) more must be readable */
+  static uint64_t load(const unsigned char *p)
+  {
+    switch (p[0])
+    {
+    case 252: return Int_reader<2>::load(p + 1);
+    case 253: return Int_reader<3>::load(p + 1);
+    case 254: return Int_reader<8>::load(p + 1);
+    default:  return p[0];
+    }
+  }
+};
+
+} // end namespace system
+} // end namespace mysql
+
+#endif	/* _INT_READER_H */
@@ -0,0 +1,106 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _LOGGING_H
+#define	_LOGGING_H
+
+#include <sstream>
+#include <string>
+
+/*
+  Log levels. A message is written if its level is at or below both the
+  compile-time level MRL_LOG_LEVEL and the runtime level set with
+  mysql::system::set_log_level().
+*/
+#define MRL_LOG_NONE    0
+#define MRL_LOG_ERROR   1
+#define MRL_LOG_WARNING 2
+#define MRL_LOG_INFO    3
+#define MRL_LOG_DEBUG   4
+
+/*
+  Messages above this level are removed by the compiler, including the
+  formatting of their arguments.
+*/
+#ifndef MRL_LOG_LEVEL
+#define MRL_LOG_LEVEL MRL_LOG_INFO
+#endif
+
+namespace mysql {
+namespace system {
+
+/**
+ * Receives every message which passes the log levels. The message doesn't
+ * end with a newline.
+ */
+typedef void (*Log_handler)(int level, const std::string &message);
+
+/**
+ * Set the runtime log level. The default is MRL_LOG_WARNING.
+ */
+void set_log_level(int level);
+int get_log_level();
+
+/**
+ * Replace the log handler. The default handler writes to std::cerr.
+ * Passing 0 restores the default handler.
+ */
+void set_log_handler(Log_handler handler);
+
+/** The runtime log level; use set_log_level() to change it. */
+extern int log_level;
+
+/**
+ * Check the runtime level. Used by the logging macros so that a message
+ * is only formatted when it will be written.
+ */
+inline bool log_enabled(int level)
+{
+  return level <= __atomic_load_n(&log_level, __ATOMIC_RELAXED);
+}
+
+void log_message(int level, const std::string &message);
+
+} // end namespace system
+} // end namespace mysql
+
+/**
+ * Log a message at the given level. The message is built with operator<<:
+ *
+ *   MRL_LOG(MRL_LOG_ERROR, "Lost connection: " << err.message());
+ */
+#define MRL_LOG(level, message)                                         \
+  do                                                                    \
+  {                                                                     \
+    if ((level) <= MRL_LOG_LEVEL &&                                     \
+        mysql::system::log_enabled(level))                              \
+    {                                                                   \
+      std::ostringstream mrl_log_stream;                                \
+      mrl_log_stream << message;                                        \
+      mysql::system::log_message(level, mrl_log_stream.str());         \
+    }                                                                   \
+  } while (0)
+
+#define MRL_ERROR(message)   MRL_LOG(MRL_LOG_ERROR, message)
+#define MRL_WARNING(message) MRL_LOG(MRL_LOG_WARNING, message)
+#define MRL_INFO(message)    MRL_LOG(MRL_LOG_INFO, message)
+#define MRL_DEBUG(message)   MRL_LOG(MRL_LOG_DEBUG, message)
+
+#endif	/* _LOGGING_H */
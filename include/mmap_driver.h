@@ -0,0 +1,134 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _MMAP_DRIVER_H
+#define	_MMAP_DRIVER_H
+
+#include <stddef.h>
+#include <string>
+
+#include "binlog_driver.h"
+#include "event_buffer.h"
+#include "protocol.h"
+
+namespace mysql {
+namespace system {
+
+/**
+ * A whole file mapped read-only into memory. Events parsed from the
+ * mapping refer into it, so it is unmapped once the last of them is
+ * released, which may be after the driver is gone.
+ */
+class Mapped_file : public Event_buffer
+{
+public:
+  /**
+   * Map the file at path.
+   *
+   * @return The mapping, which the caller holds the only reference to,
+   *         or 0 if the file couldn't be opened or mapped. An empty file
+   *         has a mapping of size 0.
+   */
+  static Mapped_file *open(const std::string &path);
+
+  size_t size() const { return capacity(); }
+
+  /**
+   * Tell the kernel how a range of the file will be read, with one of the
+   * MADV_ values of madvise().
+   */
+  void advise(size_t offset, size_t length, int advice);
+
+protected:
+  ~Mapped_file();
+
+private:
+  Mapped_file(char *data, size_t size) : Event_buffer(data, size) {}
+};
+
+/**
+ * Reads a binlog file through a memory mapping instead of a stream. The
+ * events are decoded straight from the mapping, so their payloads, such
+ * as the row images of rows events, aren't copied at all. The file is
+ * read as it was when connecting; events appended later aren't seen.
+ *
+ * Selected by create_transport() with an mmap: URL, e.g.
+ * "mmap:///var/lib/mysql/mysql-bin.000042".
+ */
+class Binlog_mmap_driver : public Binary_log_driver
+{
+public:
+  template <class TFilename>
+  Binlog_mmap_driver(const TFilename& filename = TFilename(),
+                     unsigned int offset = 0)
+    : Binary_log_driver(filename, offset), m_path(filename), m_file(0),
+      m_position(0)
+  {
+  }
+
+  ~Binlog_mmap_driver();
+
+  int connect();
+  int disconnect();
+  int wait_for_next_event(mysql::Binary_log_event **event);
+
+  /**
+   * Go to a position in the mapped file. str is empty, or the path or
+   * the name of the mapped file; any other file fails.
+   */
+  int set_position(const std::string &str, unsigned long position);
+  int get_position(std::string *str, unsigned long *position);
+
+protected:
+  /**
+   * Read from file, which the driver takes over, starting at position.
+   *
+   * @retval ERR_OK Success
+   * @retval ERR_FAIL The file isn't a binlog file; it is released
+   */
+  int attach(Mapped_file *file, unsigned long position);
+
+  /**
+   * Read the next event as wait_for_next_event() does, except at an
+   * event, or a magic number, which ends past the end of the mapping.
+   * Then short_tail is set and ERR_EOF is returned with the position left
+   * at the start of the event, as the rest may not have been written yet.
+   */
+  int read_event(mysql::Binary_log_event **event, bool *short_tail);
+
+  /**
+   * The file being read. m_binlog_file_name follows rotate events and so
+   * names the next file at the end of this one.
+   */
+  std::string m_path;
+
+  Mapped_file *m_file;
+
+  /** The offset of the next event in the file */
+  unsigned long m_position;
+
+private:
+  Log_event_header m_event_log_header;
+};
+
+} // namespace mysql::system
+} // namespace mysql
+
+#endif	/* _MMAP_DRIVER_H */
@@ -0,0 +1,164 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _MULTI_FILE_DRIVER_H
+#define	_MULTI_FILE_DRIVER_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "mmap_driver.h"
+
+/*
+  How close to the end of a binlog file the next file is opened and its
+  first bytes are read ahead
+*/
+#define MULTI_FILE_PREFETCH_SIZE (4 * 1024 * 1024)
+
+namespace mysql {
+namespace system {
+
+/**
+ * List the binlog files of a binlog index file, or those in a directory
+ * in the order of their sequence numbers. Paths in an index file are
+ * relative to its directory.
+ *
+ * @param start_file In a directory, only the files with the same base
+ *        name as start_file are listed, or those with the base name of
+ *        the first binlog file if it is empty
+ * @param[out] out The paths of the files; unchanged on failure
+ *
+ * @retval ERR_OK Success
+ * @retval ERR_FAIL The index file or directory couldn't be read
+ */
+int list_binlog_files(const std::string &source, const std::string &start_file,
+                      std::vector<std::string> &out);
+
+/**
+ * Reads a sequence of binlog files as one stream, as a replica would
+ * read them from the server. The files are those listed in a binlog
+ * index file, such as mysql-bin.index, or the binlog files in a
+ * directory, in the order of their sequence numbers.
+ *
+ * At the end of a file the driver goes on with the file named by its
+ * rotate event, or with the next file of the list if there is none. In
+ * that case it returns a rotate event without a position, like the one a
+ * server sends, so that the consumer knows which file follows.
+ * The next file is mapped and read ahead while the last
+ * MULTI_FILE_PREFETCH_SIZE bytes of the current one are processed. The
+ * list is read again at the end of the last file, so files added in the
+ * meantime are picked up, and the last file is mapped again if it grew,
+ * so events appended to it are read before the driver moves on. An event
+ * at the end of the last file which isn't complete yet is read once the
+ * rest of it has been written; until then ERR_EOF is returned.
+ *
+ * The events of every file start with its format description event.
+ * get_position() reports the path of the current file.
+ *
+ * Selected by create_transport() when a file: or mmap: URL names a
+ * directory or a file ending in ".index".
+ */
+class Binlog_multi_file_driver : public Binlog_mmap_driver
+{
+public:
+  /**
+   * @param source A binlog index file or a directory of binlog files
+   * @param start_file The file to start with, by name or path; the first
+   *        file if empty. In a directory only the files with the same
+   *        base name, e.g. mysql-bin, are read.
+   * @param offset The position in start_file to start at; 0 for its
+   *        first event
+   */
+  Binlog_multi_file_driver(const std::string &source,
+                           const std::string &start_file= "",
+                           unsigned long offset= 0);
+  ~Binlog_multi_file_driver();
+
+  int connect();
+  int disconnect();
+  int wait_for_next_event(mysql::Binary_log_event **event);
+
+  /**
+   * Go to a position in another file of the list, or in the current one
+   * if str is empty. Before connect() this sets where to start.
+   */
+  int set_position(const std::string &str, unsigned long position);
+
+  /** The files in the order they are read, once connected */
+  const std::vector<std::string> &files() const { return m_files; }
+
+private:
+  /**
+   * Read the list of files from m_source.
+   *
+   * @retval ERR_OK Success
+   * @retval ERR_FAIL The index file or directory couldn't be read
+   */
+  int load_files();
+
+  /** The index of file in m_files, matched by name, or -1 */
+  long find_file(const std::string &file) const;
+
+  /**
+   * Start reading file number index at position.
+   */
+  int open_file(size_t index, unsigned long position);
+
+  /** Map the next file and read its start ahead */
+  void prefetch();
+
+  /**
+   * Map the current file again if it grew since it was mapped, keeping
+   * the position.
+   *
+   * @retval 1 The file grew
+   * @retval 0 It didn't
+   * @retval -1 It couldn't be mapped again
+   */
+  int remap_grown_file();
+
+  std::string m_source;
+  std::string m_start_file;
+  unsigned long m_start_offset;
+
+  std::vector<std::string> m_files;
+  /**
+   * The index of the current file in m_files; m_files.size() if the file
+   * is no longer listed
+   */
+  size_t m_current;
+  bool m_connected;
+
+  /** The file named by the last rotate event */
+  std::string m_rotate_file;
+  unsigned long m_rotate_position;
+
+  /** The file after the current one, once it is prefetched */
+  Mapped_file *m_next;
+  size_t m_next_index;
+  /** True once the file after the current one was prefetched */
+  bool m_prefetched;
+};
+
+} // namespace mysql::system
+} // namespace mysql
+
+#endif	/* _MULTI_FILE_DRIVER_H */
@@ -0,0 +1,179 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _PARALLEL_DECODER_H
+#define	_PARALLEL_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <deque>
+#include <vector>
+
+#include "binlog_event.h"
+#include "decode_plan.h"
+#include "row_of_fields.h"
+
+/* The number of events a Parallel_decoder holds at most by default */
+#define PARALLEL_DECODER_WINDOW 1024
+
+namespace mysql {
+
+/**
+ * The decoded row images of one rows event, in the order of the event.
+ * An update contributes a before and an after image for every row.
+ */
+struct Decoded_rows
+{
+  Decoded_rows() : row_event(0) {}
+
+  Row_event *row_event;
+  std::vector<Row_of_fields> images;
+};
+
+/**
+ * An event submitted to a Parallel_decoder together with its decoded
+ * rows. The values refer to the memory of the event, which the result
+ * owns; deleting the result releases the event.
+ */
+class Decoded_event
+{
+public:
+  Decoded_event(Binary_log_event *ev, uint64_t seq)
+    : event(ev), sequence(seq), m_plan(0), m_ready(false)
+  {
+  }
+  ~Decoded_event();
+
+  /** The submitted event */
+  Binary_log_event *event;
+
+  /** The order in which the event was submitted, counting from 0 */
+  uint64_t sequence;
+
+  /**
+   * One entry for a rows event and one per rows event of an in memory
+   * transaction; empty for other events and for spilled transactions,
+   * whose events are read with a Transaction_event_reader.
+   */
+  std::vector<Decoded_rows> rows;
+
+private:
+  friend class Parallel_decoder;
+
+  Decoded_event(const Decoded_event&);              // Disabled copy constructor
+  Decoded_event& operator = (const Decoded_event&); // Disabled assign operator
+
+  /** The plan of a single rows event, referenced until it's decoded */
+  Decode_plan *m_plan;
+  bool m_ready;
+};
+
+/**
+ * Decodes the rows of rows events and committed transactions on a pool of
+ * worker threads and hands the results back in the order the events were
+ * submitted, which is their binlog order.
+ *
+ * One thread submits events and one thread takes the results; they may
+ * be the same thread as long as it doesn't submit while full() is true.
+ *
+ * Example:
+ *   Parallel_decoder decoder(4);
+ *   // reader thread
+ *   decoder.submit(rows_event, table_map);
+ *   decoder.submit(transaction);
+ *   // consumer thread
+ *   Decoded_event *result= decoder.next();
+ *   ...
+ *   delete result;
+ */
+class Parallel_decoder
+{
+public:
+  /**
+   * @param workers The number of worker threads
+   * @param window The largest number of submitted events which haven't
+   *               been taken with next() yet
+   */
+  explicit Parallel_decoder(size_t workers,
+                            size_t window= PARALLEL_DECODER_WINDOW);
+  ~Parallel_decoder();
+
+  /**
+   * Queue an event for decoding. The decoder takes over the event.
+   * A rows event needs the table map of its table, which is only used
+   * during the call; other events pass through in order without being
+   * decoded. Blocks while the window is full.
+   *
+   * @retval 0 Success
+   * @retval 1 A rows event without a matching table map; the event is
+   *           queued without its rows being decoded
+   */
+  int submit(Binary_log_event *event, const Table_map_event *table_map= 0);
+
+  /**
+   * Wait for the result of the oldest event not yet taken. The caller owns
+   * the result.
+   */
+  Decoded_event *next();
+
+  /**
+   * Take the result of the oldest event if it is decoded already.
+   *
+   * @return The result or 0
+   */
+  Decoded_event *try_next();
+
+  /** The number of events submitted but not taken with next() */
+  size_t pending() const;
+
+  bool full() const { return pending() >= m_window.size(); }
+
+  size_t worker_count() const { return m_workers.size(); }
+
+private:
+  Parallel_decoder(const Parallel_decoder&);              // Disabled copy constructor
+  Parallel_decoder& operator = (const Parallel_decoder&); // Disabled assign operator
+
+  static void *run_worker(void *arg);
+  void decode(Decoded_event *result);
+  Decoded_event *try_next_locked();
+
+  std::vector<pthread_t> m_workers;
+  /**
+   * The reorder buffer: the result of sequence number n is in slot
+   * n % size() from its submission until it's taken.
+   */
+  std::vector<Decoded_event *> m_window;
+  /** Results waiting for a worker */
+  std::deque<Decoded_event *> m_work;
+  uint64_t m_submitted;
+  uint64_t m_delivered;
+  bool m_shutdown;
+
+  mutable pthread_mutex_t m_mutex;
+  pthread_cond_t m_work_available;
+  pthread_cond_t m_result_ready;
+  pthread_cond_t m_slot_free;
+};
+
+} // end namespace mysql
+
+#endif	/* _PARALLEL_DECODER_H */
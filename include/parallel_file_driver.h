@@ -0,0 +1,148 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _PARALLEL_FILE_DRIVER_H
+#define	_PARALLEL_FILE_DRIVER_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#include "binlog_driver.h"
+#include "spsc_queue.h"
+#include "threaded_pipeline.h"
+
+/* The number of events parsed ahead of the consumer in every file */
+#define PARALLEL_SCAN_READ_AHEAD 4096
+
+namespace mysql {
+namespace system {
+
+/**
+ * Reads a sequence of binlog files with several threads, each parsing a
+ * file of its own, and returns the events in the order of the files and
+ * of the positions within them, as if one driver read them all.
+ *
+ * Up to threads files are parsed at a time, the one being returned and
+ * the ones after it. A file is taken up as soon as the file threads
+ * positions before it is used up. Every file holds at most read_ahead
+ * parsed events, so memory use stays bounded however far the threads get
+ * ahead of the consumer. The files are read with Binlog_mmap_driver,
+ * with the event mask and table filter of this driver. A file which
+ * doesn't end with a rotate event naming the next one is followed by a
+ * rotate event without a position, as Binlog_multi_file_driver does.
+ *
+ * Meant for reprocessing archived binlogs, whose files don't change.
+ *
+ * Example:
+ *   std::vector<std::string> files;
+ *   list_binlog_files("/archive/mysql-bin.index", "", files);
+ *   Binary_log binlog(new Binlog_parallel_file_driver(files, 16));
+ *   binlog.connect();
+ *   while (binlog.wait_for_next_event(&event) == ERR_OK)
+ *     ...
+ */
+class Binlog_parallel_file_driver : public Binary_log_driver
+{
+public:
+  /**
+   * @param files The paths of the binlog files, in order
+   * @param threads The number of files parsed at a time
+   * @param read_ahead The number of events parsed ahead in every file
+   */
+  Binlog_parallel_file_driver(const std::vector<std::string> &files,
+                              size_t threads,
+                              size_t read_ahead= PARALLEL_SCAN_READ_AHEAD);
+  ~Binlog_parallel_file_driver();
+
+  int connect();
+  int disconnect();
+  int wait_for_next_event(mysql::Binary_log_event **event);
+
+  /**
+   * Start over at position in the file str, given by name or path, or in
+   * the current file if str is empty. Before connect() this sets where to
+   * start.
+   */
+  int set_position(const std::string &str, unsigned long position);
+
+  /** The path of the current file and the end of the last event returned */
+  int get_position(std::string *str, unsigned long *position);
+
+  void interrupt();
+  void resume();
+
+private:
+  Binlog_parallel_file_driver(const Binlog_parallel_file_driver&);
+  Binlog_parallel_file_driver& operator = (const Binlog_parallel_file_driver&);
+
+  typedef spsc_queue<Pipeline_item> Item_queue;
+
+  static void *run_worker(void *arg);
+  void scan(size_t index);
+  /**
+   * Queue an item of file index, waiting while the queue is full or
+   * interrupted.
+   *
+   * @retval false The driver is stopping
+   */
+  bool push(size_t index, const Pipeline_item &item);
+  bool stopping() const
+  {
+    return __atomic_load_n(&m_stopping, __ATOMIC_ACQUIRE) != 0;
+  }
+
+  std::vector<std::string> m_files;
+  size_t m_thread_count;
+  size_t m_read_ahead;
+
+  /** Where connect() starts */
+  size_t m_start_index;
+  unsigned long m_start_offset;
+
+  /** The parsed events of every file, from connect() on */
+  std::vector<Item_queue *> m_queues;
+  std::vector<pthread_t> m_threads;
+  bool m_connected;
+  int m_stopping;
+
+  /** The file being returned; the first one not used up */
+  size_t m_current;
+  /** The end of the last event returned */
+  unsigned long m_position;
+  /** The file named by the last event returned if it was a rotate event */
+  std::string m_rotate_file;
+  /** The next file to be taken up by a thread */
+  size_t m_next_file;
+  /** For every file, true once its thread is done with its queue */
+  std::vector<char> m_finished;
+  /** The error which ended the current file */
+  int m_error;
+  bool m_interrupted;
+
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_changed;
+};
+
+} // namespace mysql::system
+} // namespace mysql
+
+#endif	/* _PARALLEL_FILE_DRIVER_H */
@@ -23,6 +23,9 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 #include <asio.hpp>
 #include <list>
 #include "binlog_event.h"
+#include "buffer_decoder.h"
+#include "event_pool.h"
+#include "int_reader.h"
 
 using asio::ip::tcp;
 namespace mysql {
@@ -299,6 +302,9 @@ public:
     m_size= new_size;
   }
 private:
+  template <typename U>
+  friend std::istream &operator>>(std::istream &is, Protocol_chunk<U> &chunk);
+
   const char *m_data;
   unsigned long m_size;
 };
@@ -372,6 +378,21 @@ private:
 
 };
 
+/**
+ * A read-only stream buffer over a block of memory which is owned by
+ * someone else. Used to parse a package in place without first copying
+ * it into an asio::streambuf.
+ */
+class Memory_streambuf : public std::streambuf
+{
+public:
+    Memory_streambuf(const char *src, std::size_t sz)
+    {
+        char *ptr= const_cast<char *>(src);
+        setg(ptr, ptr, ptr + sz);
+    }
+};
+
 class Protocol_chunk_string_len
 {
 public:
@@ -392,6 +413,34 @@ std::istream &operator>>(std::istream &is, std::string &str);
 std::istream &operator>>(std::istream &is, Protocol_chunk_string_len &lenstr);
 std::istream &operator>>(std::istream &is, Protocol_chunk_string &str);
 
+/**
+ * Reads a chunk which stores a single integer with one read and one load.
+ * Chunks over a buffer of another size are read by the generic reader.
+ */
+template <typename T>
+std::istream &operator>>(std::istream &is, Protocol_chunk<T> &chunk)
+{
+  if (chunk.m_size != sizeof(T))
+    return is >> static_cast<Protocol &>(chunk);
+
+  if (chunk.is_length_encoded_binary())
+  {
+    unsigned char buf[9];
+    if (!is.read((char *)buf, 1))
+      return is;
+    unsigned int extra= Length_encoded_reader::extra_bytes(buf[0]);
+    if (extra > 0 && !is.read((char *)buf + 1, extra))
+      return is;
+    *(T *)chunk.m_data= (T) Length_encoded_reader::load(buf);
+    return is;
+  }
+
+  unsigned char buf[sizeof(T)];
+  if (is.read((char *)buf, sizeof(T)))
+    *(T *)chunk.m_data= (T) Int_reader<sizeof(T)>::load(buf);
+  return is;
+}
+
 int proto_read_package_header(tcp::socket *socket, unsigned long *packet_length, unsigned char *packet_no);
 
 /**
@@ -418,16 +467,45 @@ void prot_parse_eof_message(std::istream &is, struct st_eof_package &eof);
 void proto_get_handshake_package(std::istream &is, struct st_handshake_package &p, int packet_length);
 
 /**
-  Allocates a new event and copy the header. The caller must be responsible for
-  releasing the allocated memory.
+  Decode the common event header, excluding the leading marker byte of a
+  network package.
+*/
+void proto_event_header(Buffer_decoder &dec, Log_event_header *h);
+
+/**
+  Allocates a new event, or takes one from pool if it isn't 0, and copy the
+  header. The caller must be responsible for releasing the event with
+  release_event().
+*/
+Query_event *proto_query_event(Buffer_decoder &dec, Log_event_header *header,
+                               Event_pool *pool= 0);
+Rotate_event *proto_rotate_event(Buffer_decoder &dec, Log_event_header *header,
+                                 Event_pool *pool= 0);
+Incident_event *proto_incident_event(Buffer_decoder &dec,
+                                     Log_event_header *header,
+                                     Event_pool *pool= 0);
+Row_event *proto_rows_event(Buffer_decoder &dec, Log_event_header *header,
+                            Event_pool *pool= 0);
+Table_map_event *proto_table_map_event(Buffer_decoder &dec,
+                                       Log_event_header *header,
+                                       Event_pool *pool= 0);
+Int_var_event *proto_intvar_event(Buffer_decoder &dec, Log_event_header *header,
+                                  Event_pool *pool= 0);
+User_var_event *proto_uservar_event(Buffer_decoder &dec,
+                                    Log_event_header *header,
+                                    Event_pool *pool= 0);
+Xid *proto_xid_event(Buffer_decoder &dec, Log_event_header *header,
+                     Event_pool *pool= 0);
+
+/**
+  Encode a table map or rows event the way it is stored in a binlog file:
+  the common header without the marker, followed by the body. The event
+  length in the header is set to the encoded size. Decode the result with
+  proto_event_header() and the proto_*_event() function of the type.
+
+  @return False if events of this type can't be encoded
 */
-Query_event *proto_query_event(std::istream &is, Log_event_header *header);
-Rotate_event *proto_rotate_event(std::istream &is, Log_event_header *header);
-Incident_event *proto_incident_event(std::istream &is, Log_event_header *header);
-Row_event *proto_rows_event(std::istream &is, Log_event_header *header);
-Table_map_event *proto_table_map_event(std::istream &is, Log_event_header *header);
-Int_var_event *proto_intvar_event(std::istream &is, Log_event_header *header);
-User_var_event *proto_uservar_event(std::istream &is, Log_event_header *header);
+bool proto_encode_event(std::vector<char> &out, Binary_log_event *event);
 
 } // end namespace system
 } // end namespace mysql
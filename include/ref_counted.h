@@ -0,0 +1,85 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _REF_COUNTED_H
+#define	_REF_COUNTED_H
+
+namespace mysql {
+
+/**
+ * Base class for objects which are shared between threads and destroyed
+ * when the last reference is released. A new object starts with one
+ * reference which belongs to the creator.
+ */
+class Ref_counted
+{
+public:
+  Ref_counted() : m_ref_count(1) {}
+
+  void add_ref()
+  {
+    __atomic_add_fetch(&m_ref_count, 1, __ATOMIC_RELAXED);
+  }
+
+  void release()
+  {
+    if (__atomic_sub_fetch(&m_ref_count, 1, __ATOMIC_ACQ_REL) == 0)
+      destroy();
+  }
+
+  /**
+   * Release count references at once.
+   */
+  void release(int count)
+  {
+    if (__atomic_sub_fetch(&m_ref_count, count, __ATOMIC_ACQ_REL) == 0)
+      destroy();
+  }
+
+  /**
+   * True if nobody but the caller holds a reference.
+   */
+  bool is_unique() const
+  {
+    return __atomic_load_n(&m_ref_count, __ATOMIC_ACQUIRE) == 1;
+  }
+
+protected:
+  virtual ~Ref_counted() {}
+
+  /**
+   * Called when the reference count drops to zero. The default is to
+   * delete the object; a pooled object can be recycled instead after
+   * calling reset_ref_count().
+   */
+  virtual void destroy() { delete this; }
+
+  void reset_ref_count() { m_ref_count= 1; }
+
+private:
+  Ref_counted(const Ref_counted&);              // Disabled copy constructor
+  Ref_counted& operator = (const Ref_counted&); // Disabled assign operator
+
+  int m_ref_count;
+};
+
+} // end namespace mysql
+
+#endif	/* _REF_COUNTED_H */
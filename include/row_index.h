@@ -0,0 +1,167 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _ROW_INDEX_H
+#define	_ROW_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "binlog_event.h"
+#include "decode_plan.h"
+#include "row_of_fields.h"
+
+namespace mysql {
+
+/**
+ * One row image of a rows event: the null bits followed by the values of
+ * the columns which aren't NULL.
+ */
+class Row_image
+{
+public:
+  Row_image() : m_plan(0), m_null_bits(0), m_data(0), m_length(0) {}
+  Row_image(const Decode_plan *plan, const unsigned char *null_bits,
+            const unsigned char *data, size_t length)
+    : m_plan(plan), m_null_bits(null_bits), m_data(data), m_length(length)
+  {
+  }
+
+  /** False for the missing image of a row, e.g. the before image of an insert */
+  bool valid() const { return m_null_bits != 0; }
+
+  const unsigned char *null_bits() const { return m_null_bits; }
+  bool is_null(size_t col_no) const
+  {
+    return (m_null_bits[col_no / 8] & (1 << (col_no & 7))) != 0;
+  }
+
+  /** The values of the row, not including the null bits */
+  const unsigned char *data() const { return m_data; }
+  size_t length() const { return m_length; }
+
+  /**
+   * Decode the values of the row and append them to fields.
+   */
+  void fields(Row_of_fields &fields) const
+  {
+    m_plan->decode_row(m_null_bits, 0, m_data - m_null_bits, fields);
+  }
+
+  /**
+   * Decode only the columns in projection.
+   */
+  void fields(const Column_projection &projection, Row_of_fields &fields) const
+  {
+    m_plan->decode_row(m_null_bits, 0, m_data - m_null_bits, &projection,
+                       fields);
+  }
+
+private:
+  const Decode_plan *m_plan;
+  const unsigned char *m_null_bits;
+  const unsigned char *m_data;
+  size_t m_length;
+};
+
+/**
+ * The offsets of all row images of a rows event, found in one pass over
+ * the event without decoding any value. Rows can then be counted, skipped
+ * or decoded in any order, or split into ranges for several threads.
+ *
+ * An UPDATE_ROWS_EVENT holds a before and an after image for every row;
+ * a row of the index is such a pair. For WRITE_ROWS_EVENT a row only has
+ * an after image and for DELETE_ROWS_EVENT only a before image.
+ *
+ * The index refers to the memory of the events, which must outlive it.
+ */
+class Row_index
+{
+public:
+  Row_index(const Row_event *row_event, const Table_map_event *table_map);
+
+  /**
+   * Index the rows with a decode plan kept elsewhere, such as in a
+   * Table_schema. The plan must outlive the index.
+   */
+  Row_index(const Row_event *row_event, const Decode_plan *plan);
+
+  /** The number of rows */
+  size_t size() const { return m_rows; }
+  bool empty() const { return m_rows == 0; }
+
+  /** The number of row images; twice the number of rows for updates */
+  size_t image_count() const { return m_offsets.size() - 1; }
+
+  /**
+   * The image of row n which holds the row as it is after the event: the
+   * after image of an update or insert, the before image of a delete.
+   */
+  Row_image operator[](size_t n) const
+  {
+    return image(m_is_update ? 2 * n + 1 : n);
+  }
+
+  /** The before image of row n; not valid for inserts */
+  Row_image before(size_t n) const
+  {
+    if (m_is_update)
+      return image(2 * n);
+    return m_is_write ? Row_image() : image(n);
+  }
+
+  /** The after image of row n; not valid for deletes */
+  Row_image after(size_t n) const
+  {
+    if (m_is_update)
+      return image(2 * n + 1);
+    return m_is_write ? image(n) : Row_image();
+  }
+
+  /** Row image number n, in the order of the event */
+  Row_image image(size_t n) const
+  {
+    const unsigned char *null_bits= m_row + m_offsets[n];
+    return Row_image(m_plan, null_bits, null_bits + m_null_bits_len,
+                     m_offsets[n + 1] - m_offsets[n] - m_null_bits_len);
+  }
+
+  /** The offset of row image n in Row_event::row */
+  size_t image_offset(size_t n) const { return m_offsets[n]; }
+
+private:
+  void build(const Row_event *row_event);
+
+  const Decode_plan *m_plan;
+  const unsigned char *m_row;
+  size_t m_null_bits_len;
+  bool m_is_update;
+  bool m_is_write;
+  size_t m_rows;
+  /**
+   * The offset of every row image followed by the end of the last one.
+   */
+  std::vector<uint32_t> m_offsets;
+};
+
+} // end namespace mysql
+
+#endif	/* _ROW_INDEX_H */
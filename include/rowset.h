@@ -38,15 +38,23 @@ public:
 
     Row_event_set(Row_event *arg1, Table_map_event *arg2) { source(arg1, arg2); }
 
-    iterator begin() { return iterator(m_row_event, m_table_map_event); }
+    iterator begin() { return iterator(m_row_event, m_table_map_event, &m_projection); }
     iterator end() { return iterator(); }
-    const_iterator begin() const { return const_iterator(m_row_event, m_table_map_event); }
+    const_iterator begin() const { return const_iterator(m_row_event, m_table_map_event, &m_projection); }
     const_iterator end() const { return const_iterator(); }
 
+    /**
+     * Only decode the columns in projection. Dereferenced iterators then
+     * return the values of these columns in column order; the other
+     * columns are stepped over without being decoded.
+     */
+    void set_projection(const Column_projection &projection) { m_projection= projection; }
+
 private:
     void source(Row_event *arg1, Table_map_event *arg2) { m_row_event= arg1; m_table_map_event= arg2; }
     Row_event *m_row_event;
     Table_map_event *m_table_map_event;
+    Column_projection m_projection;
 };
 
 }
@@ -0,0 +1,325 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _SHARD_DISPATCHER_H
+#define	_SHARD_DISPATCHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "binlog_event.h"
+#include "basic_content_handler.h"
+#include "basic_transaction_parser.h"
+#include "row_index.h"
+#include "spsc_queue.h"
+
+/* The default capacity of the queue of every shard, in rows */
+#define SHARD_QUEUE_SIZE 1024
+
+namespace mysql {
+
+/**
+ * One changed row as handed to a Shard_applier. The images and events
+ * are only valid during the call.
+ */
+struct Row_change
+{
+  Row_change() : row_event(0), table_map(0) {}
+
+  Row_event *row_event;
+  Table_map_event *table_map;
+  /** Not valid for inserts */
+  Row_image before;
+  /** Not valid for deletes */
+  Row_image after;
+};
+
+/**
+ * Applies row changes to a downstream store. apply() is called on the
+ * thread of the shard, so calls for different shards run concurrently
+ * and calls for one shard never do.
+ */
+class Shard_applier
+{
+public:
+  virtual ~Shard_applier() {}
+
+  /**
+   * Apply one row change.
+   *
+   * @retval 0 Success
+   * @retval other The change couldn't be applied. The dispatcher stops
+   *               applying and the watermark doesn't move any more; see
+   *               Shard_dispatcher::failed().
+   */
+  virtual int apply(size_t shard, const Row_change &change)= 0;
+};
+
+/**
+ * Computes the key on which rows are distributed over the shards. Rows
+ * with the same key go to the same shard and are applied in binlog order.
+ * Derive from it to shard on a key of one's own.
+ */
+class Shard_key
+{
+public:
+  virtual ~Shard_key() {}
+
+  /**
+   * The hash of the key of a row image.
+   */
+  virtual uint64_t hash(const Table_map_event *table_map,
+                        const Row_image &image) const= 0;
+
+  /**
+   * True if the key only depends on the table, so that one hash serves
+   * all rows of a rows event.
+   */
+  virtual bool is_per_table() const { return false; }
+};
+
+/**
+ * Keys rows on their table, so that all changes of a table are applied in
+ * order by one shard. The default key of a Shard_dispatcher.
+ */
+class Table_shard_key : public Shard_key
+{
+public:
+  uint64_t hash(const Table_map_event *table_map, const Row_image &image) const;
+  bool is_per_table() const { return true; }
+};
+
+/**
+ * Keys rows on the values of some of their columns, usually the primary
+ * key. The table map doesn't say which columns make up the primary key,
+ * so they are configured per table; the first column is used for other
+ * tables.
+ *
+ * Example:
+ *   Column_shard_key key;
+ *   std::vector<size_t> columns;
+ *   columns.push_back(0);
+ *   columns.push_back(2);
+ *   key.set_columns("shop", "order_line", columns);
+ *   dispatcher.set_key(&key);
+ */
+class Column_shard_key : public Shard_key
+{
+public:
+  Column_shard_key();
+
+  /**
+   * Key the rows of db.table on the given column numbers. Call it before
+   * the key is used.
+   */
+  void set_columns(const std::string &db, const std::string &table,
+                   const std::vector<size_t> &columns);
+
+  uint64_t hash(const Table_map_event *table_map, const Row_image &image) const;
+
+private:
+  const std::vector<size_t> &columns(const Table_map_event *table_map) const;
+
+  typedef std::map<std::string, std::vector<size_t> > Table_columns;
+  /** The key columns by database and table name */
+  std::map<std::string, Table_columns> m_columns;
+  std::vector<size_t> m_default_columns;
+};
+
+/**
+ * Applies the row changes of the binlog on several threads. Every row is
+ * hashed on a Shard_key and queued to one of the shards, which applies
+ * its rows in binlog order with a Shard_applier. Rows with the same key
+ * thus keep their order while the shards make progress in parallel.
+ *
+ * The handler consumes rows events, their table maps and transactions
+ * of a Basic_transaction_parser, whether buffered, spilled or streamed.
+ * Everything else is passed on, as are rows events whose table map
+ * wasn't seen. Statements other than BEGIN and COMMIT wait until all
+ * rows before them are applied. So does an update which moves a row to
+ * another key, which is applied alone.
+ *
+ * The watermark is the position after the last transaction which is
+ * applied together with everything before it; a restart from there
+ * doesn't miss any change.
+ *
+ * Example:
+ *   Shard_dispatcher dispatcher(8, &applier);
+ *   binlog.content_handler_pipeline()->push_back(&dispatcher);
+ *   ...
+ *   std::string file;
+ *   unsigned long position= dispatcher.applied_position(file);
+ */
+class Shard_dispatcher : public Content_handler
+{
+public:
+  /**
+   * @param shards The number of shards, each with a thread of its own
+   * @param applier Applies the rows; must outlive the dispatcher
+   * @param queue_size The number of rows a shard may have queued
+   */
+  Shard_dispatcher(size_t shards, Shard_applier *applier,
+                   size_t queue_size= SHARD_QUEUE_SIZE);
+
+  /**
+   * Applies the queued rows and stops the threads. The watermark then
+   * covers everything handed to the dispatcher unless it failed.
+   */
+  ~Shard_dispatcher();
+
+  enum { handled_events= HANDLES_QUERY | HANDLES_ROWS | HANDLES_TABLE_MAP |
+                         HANDLES_XID | HANDLES_ROTATE | HANDLES_OTHER };
+  typedef Shard_dispatcher handled_events_class;
+
+  mysql::Binary_log_event *process_event(mysql::Query_event *ev);
+  mysql::Binary_log_event *process_event(mysql::Row_event *ev);
+  mysql::Binary_log_event *process_event(mysql::Table_map_event *ev);
+  mysql::Binary_log_event *process_event(mysql::Xid *ev);
+  mysql::Binary_log_event *process_event(mysql::Rotate_event *ev);
+  mysql::Binary_log_event *process_event(mysql::Binary_log_event *ev);
+
+  /**
+   * Use key instead of a Table_shard_key. The key must outlive the
+   * dispatcher; call it before the first event.
+   */
+  void set_key(Shard_key *key) { m_key= key; }
+
+  size_t shard_count() const { return m_shards.size(); }
+
+  /**
+   * The watermark: the position up to which all changes are applied.
+   *
+   * @param[out] filename The binlog file of the position, if known
+   */
+  unsigned long applied_position(std::string &filename) const;
+  unsigned long applied_position() const;
+
+  /**
+   * Wait until all transactions handed to the dispatcher so far are
+   * applied, or until it failed.
+   */
+  void wait_until_applied();
+
+  /**
+   * True if the applier failed. Later rows are not applied and the
+   * watermark stays where it was.
+   */
+  bool failed() const
+  {
+    return __atomic_load_n(&m_failed, __ATOMIC_ACQUIRE) != 0;
+  }
+
+  /** The first error returned by the applier, or 0 */
+  int error() const { return __atomic_load_n(&m_error, __ATOMIC_ACQUIRE); }
+
+private:
+  Shard_dispatcher(const Shard_dispatcher&);              // Disabled copy constructor
+  Shard_dispatcher& operator = (const Shard_dispatcher&); // Disabled assign operator
+
+  class Batch;
+  friend class Batch;
+
+  enum Work_kind { WORK_ROW, WORK_BARRIER, WORK_STOP };
+
+  struct Shard_work
+  {
+    int kind;
+    /** The batch which owns the events of the change */
+    Batch *batch;
+    Row_change change;
+  };
+
+  struct Shard
+  {
+    Shard_dispatcher *dispatcher;
+    size_t number;
+    spsc_queue<Shard_work> *queue;
+    pthread_t thread;
+    bool running;
+  };
+
+  /** A transaction in the watermark */
+  struct Watermark_entry
+  {
+    bool applied;
+    std::string file;
+    unsigned long position;
+  };
+
+  static void *run_shard(void *arg);
+  void apply(Shard *shard, const Shard_work &work);
+  void fail(int error);
+
+  Batch *current_batch();
+  /**
+   * Queue all rows of a rows event.
+   */
+  void dispatch(Row_event *row_event, Table_map_event *table_map);
+  void push(size_t shard, const Shard_work &work);
+  void push_row(size_t shard, const Row_change &change);
+  /**
+   * Wait until the shards applied everything queued so far.
+   */
+  void barrier();
+  /**
+   * End the current transaction at the end of event.
+   */
+  void commit(Binary_log_event *event);
+  void add_watermark_entry(Batch *batch, unsigned long position);
+  void batch_applied(uint64_t sequence);
+  /** Called with m_mutex held */
+  void advance_watermark();
+  void process_transaction(Transaction_log_event *trans);
+
+  Shard_applier *m_applier;
+  Shard_key *m_key;
+  Table_shard_key m_table_key;
+  std::vector<Shard> m_shards;
+
+  /** The transaction being dispatched, or 0 if it has no rows yet */
+  Batch *m_batch;
+  /** The table maps of the current transaction */
+  std::map<uint64_t, Table_map_event *> m_table_maps;
+  /** True between BEGIN and the commit of a transaction */
+  bool m_in_transaction;
+  /** The binlog file of the events, as given by rotate events */
+  std::string m_file;
+
+  mutable pthread_mutex_t m_mutex;
+  pthread_cond_t m_changed;
+  /** The transactions which aren't applied yet or just were */
+  std::deque<Watermark_entry> m_watermark;
+  /** The sequence number of the first entry of m_watermark */
+  uint64_t m_first_sequence;
+  std::string m_applied_file;
+  unsigned long m_applied_position;
+  size_t m_barrier_count;
+  int m_failed;
+  int m_error;
+};
+
+} // end namespace mysql
+
+#endif	/* _SHARD_DISPATCHER_H */
@@ -0,0 +1,290 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _SPSC_QUEUE_H
+#define	_SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define CACHE_LINE_SIZE 64
+
+/**
+ * A bounded, lock-free ring queue for exactly one producer thread and
+ * one consumer thread.
+ *
+ * The capacity is rounded up to a power of two so that a slot is found by
+ * masking the free running read and write counters. Each counter lives on
+ * its own cache line together with a private copy of the other side's
+ * counter, so the two threads only share a cache line when the cached copy
+ * is stale.
+ *
+ * push_front() and pop_back() block when the queue is full or empty; they
+ * spin for a short while and then park on a condition variable. The mutex
+ * is only taken when one of the sides is actually parked.
+ *
+ * close() makes blocked and later wait_push() and wait_pop() calls return
+ * instead of waiting, so that a thread parked on the queue can be stopped
+ * from any thread. push_front() and pop_back() ignore it, so that a
+ * producer which must not lose items keeps waiting for room.
+ */
+template <class T>
+class spsc_queue
+{
+public:
+
+  typedef T value_type;
+  typedef size_t size_type;
+
+  explicit spsc_queue(size_type capacity)
+    : m_head(0), m_cached_tail(0), m_tail(0), m_cached_head(0),
+      m_consumer_waiting(0), m_producer_waiting(0), m_closed(0)
+  {
+    m_capacity= 1;
+    while (m_capacity < capacity)
+      m_capacity <<= 1;
+    m_mask= m_capacity - 1;
+    m_ring= new value_type[m_capacity];
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_not_empty, NULL);
+    pthread_cond_init(&m_not_full, NULL);
+  }
+
+  ~spsc_queue()
+  {
+    delete [] m_ring;
+    pthread_mutex_destroy(&m_mutex);
+    pthread_cond_destroy(&m_not_empty);
+    pthread_cond_destroy(&m_not_full);
+  }
+
+  /**
+   * Append an item; blocks while the queue is full, even if it is closed.
+   * Must only be called from the producer thread.
+   */
+  void push_front(const value_type& item)
+  {
+    push(item, false);
+  }
+
+  /**
+   * Remove the oldest item; blocks while the queue is empty, even if it is
+   * closed.
+   * Must only be called from the consumer thread.
+   */
+  void pop_back(value_type *pItem)
+  {
+    pop(pItem, false);
+  }
+
+  /**
+   * Append an item, waiting while the queue is full.
+   * @retval false The queue was closed while full; the item isn't queued
+   */
+  bool wait_push(const value_type& item)
+  {
+    return push(item, true);
+  }
+
+  /**
+   * Remove the oldest item, waiting while the queue is empty.
+   * @retval false The queue was closed while empty; pItem is unchanged
+   */
+  bool wait_pop(value_type *pItem)
+  {
+    return pop(pItem, true);
+  }
+
+  /**
+   * Wake both sides and make wait_push() and wait_pop() stop waiting for
+   * items or room until reopen(). May be called from any thread.
+   */
+  void close()
+  {
+    pthread_mutex_lock(&m_mutex);
+    __atomic_store_n(&m_closed, 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&m_not_empty);
+    pthread_cond_broadcast(&m_not_full);
+    pthread_mutex_unlock(&m_mutex);
+  }
+
+  void reopen()
+  {
+    __atomic_store_n(&m_closed, 0, __ATOMIC_RELEASE);
+  }
+
+  bool is_closed() const
+  {
+    return __atomic_load_n(&m_closed, __ATOMIC_ACQUIRE) != 0;
+  }
+
+  /**
+   * Non-blocking push.
+   * @retval true The item was queued
+   * @retval false The queue is full
+   */
+  bool try_push(const value_type& item)
+  {
+    size_type tail= m_tail;
+    if (tail - m_cached_head == m_capacity)
+    {
+      m_cached_head= __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+      if (tail - m_cached_head == m_capacity)
+        return false;
+    }
+    m_ring[tail & m_mask]= item;
+    __atomic_store_n(&m_tail, tail + 1, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&m_consumer_waiting, __ATOMIC_RELAXED))
+      wake(&m_not_empty);
+    return true;
+  }
+
+  /**
+   * Non-blocking pop.
+   * @retval true An item was stored in pItem
+   * @retval false The queue is empty
+   */
+  bool try_pop(value_type *pItem)
+  {
+    size_type head= m_head;
+    if (head == m_cached_tail)
+    {
+      m_cached_tail= __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE);
+      if (head == m_cached_tail)
+        return false;
+    }
+    *pItem= m_ring[head & m_mask];
+    __atomic_store_n(&m_head, head + 1, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&m_producer_waiting, __ATOMIC_RELAXED))
+      wake(&m_not_full);
+    return true;
+  }
+
+  bool has_unread()
+  {
+    return __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE) !=
+           __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+  }
+
+  size_type capacity() const { return m_capacity; }
+
+private:
+  spsc_queue(const spsc_queue&);              // Disabled copy constructor
+  spsc_queue& operator = (const spsc_queue&); // Disabled assign operator
+
+  enum { SPIN_LIMIT= 256, YIELD_LIMIT= 64 };
+
+  bool push(const value_type& item, bool interruptible)
+  {
+    for (int spin= 0; !try_push(item); ++spin)
+    {
+      if (interruptible && is_closed())
+        return false;
+      if (spin < SPIN_LIMIT)
+        continue;
+      if (spin < SPIN_LIMIT + YIELD_LIMIT)
+      {
+        sched_yield();
+        continue;
+      }
+      wait_not_full(interruptible);
+      spin= 0;
+    }
+    return true;
+  }
+
+  bool pop(value_type *pItem, bool interruptible)
+  {
+    for (int spin= 0; !try_pop(pItem); ++spin)
+    {
+      if (interruptible && is_closed())
+        return false;
+      if (spin < SPIN_LIMIT)
+        continue;
+      if (spin < SPIN_LIMIT + YIELD_LIMIT)
+      {
+        sched_yield();
+        continue;
+      }
+      wait_not_empty(interruptible);
+      spin= 0;
+    }
+    return true;
+  }
+
+  void wait_not_empty(bool interruptible)
+  {
+    pthread_mutex_lock(&m_mutex);
+    __atomic_store_n(&m_consumer_waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&m_tail, __ATOMIC_ACQUIRE) == m_head &&
+           !(interruptible && is_closed()))
+      pthread_cond_wait(&m_not_empty, &m_mutex);
+    __atomic_store_n(&m_consumer_waiting, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&m_mutex);
+  }
+
+  void wait_not_full(bool interruptible)
+  {
+    pthread_mutex_lock(&m_mutex);
+    __atomic_store_n(&m_producer_waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (m_tail - __atomic_load_n(&m_head, __ATOMIC_ACQUIRE) == m_capacity &&
+           !(interruptible && is_closed()))
+      pthread_cond_wait(&m_not_full, &m_mutex);
+    __atomic_store_n(&m_producer_waiting, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&m_mutex);
+  }
+
+  void wake(pthread_cond_t *cond)
+  {
+    pthread_mutex_lock(&m_mutex);
+    pthread_cond_signal(cond);
+    pthread_mutex_unlock(&m_mutex);
+  }
+
+  /* Consumer owned */
+  char m_pad0[CACHE_LINE_SIZE];
+  size_type m_head;
+  size_type m_cached_tail;
+
+  /* Producer owned */
+  char m_pad1[CACHE_LINE_SIZE - 2 * sizeof(size_type)];
+  size_type m_tail;
+  size_type m_cached_head;
+
+  /* Shared, read-mostly */
+  char m_pad2[CACHE_LINE_SIZE - 2 * sizeof(size_type)];
+  int m_consumer_waiting;
+  int m_producer_waiting;
+  int m_closed;
+  size_type m_capacity;
+  size_type m_mask;
+  value_type *m_ring;
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_not_empty;
+  pthread_cond_t m_not_full;
+  char m_pad3[CACHE_LINE_SIZE];
+};
+
+#endif	/* _SPSC_QUEUE_H */
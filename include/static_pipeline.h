@@ -0,0 +1,278 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _STATIC_PIPELINE_H
+#define	_STATIC_PIPELINE_H
+
+#include "binlog_event.h"
+#include "basic_content_handler.h"
+
+namespace mysql {
+
+template <class T, class U>
+struct Static_same_class { enum { value= 0 }; };
+
+template <class T>
+struct Static_same_class<T, T> { enum { value= 1 }; };
+
+/**
+ * The overload groups a Static_stage calls Handler for. A handler which
+ * inherits a narrowed handled_events may override other overloads, so
+ * it is called for all of them.
+ */
+template <class Handler>
+struct Static_handled_events
+{
+  enum { value= Static_same_class<Handler,
+                                  typename Handler::handled_events_class>::value ?
+                (int) Handler::handled_events : (int) HANDLES_ALL };
+};
+
+/**
+ * Ends a chain of Static_stage.
+ */
+class Static_stage_end
+{
+public:
+  enum { handled_events= 0 };
+
+  template <int Kind, class Event>
+  Binary_log_event *process(Event *ev) { return ev; }
+
+  Binary_log_event *dispatch(Binary_log_event *ev) { return ev; }
+
+  void set_injection_queue(Injection_queue *) {}
+};
+
+/**
+ * Run an event through a chain of stages, choosing the overload by the
+ * type of the event once for all of them.
+ */
+template <class Stage>
+Binary_log_event *dispatch_static(Stage &stage, Binary_log_event *ev)
+{
+  switch (ev->header()->type_code)
+  {
+  case QUERY_EVENT:
+    return stage.template process<HANDLES_QUERY>(static_cast<Query_event *>(ev));
+  case WRITE_ROWS_EVENT:
+  case UPDATE_ROWS_EVENT:
+  case DELETE_ROWS_EVENT:
+    return stage.template process<HANDLES_ROWS>(static_cast<Row_event *>(ev));
+  case TABLE_MAP_EVENT:
+    return stage.template process<HANDLES_TABLE_MAP>(static_cast<Table_map_event *>(ev));
+  case XID_EVENT:
+    return stage.template process<HANDLES_XID>(static_cast<Xid *>(ev));
+  case USER_VAR_EVENT:
+    return stage.template process<HANDLES_USER_VAR>(static_cast<User_var_event *>(ev));
+  case INCIDENT_EVENT:
+    return stage.template process<HANDLES_INCIDENT>(static_cast<Incident_event *>(ev));
+  case ROTATE_EVENT:
+    return stage.template process<HANDLES_ROTATE>(static_cast<Rotate_event *>(ev));
+  default:
+    return stage.template process<HANDLES_OTHER>(ev);
+  }
+}
+
+/**
+ * One handler of a Static_pipeline followed by the rest of the chain. The
+ * handler is a member of known type, so the compiler calls its
+ * process_event() overloads directly and can inline them.
+ */
+template <class Handler, class Next>
+class Static_stage
+{
+public:
+  typedef Handler handler_type;
+  typedef Next next_type;
+
+  enum { handled_events= Static_handled_events<Handler>::value |
+                         Next::handled_events };
+
+  Handler &handler() { return m_handler; }
+  Next &next() { return m_next; }
+
+  /**
+   * Process an event whose overload group is Kind. Handlers which don't
+   * handle Kind are left out at compile time. If a handler returns
+   * another event, the rest of the chain dispatches on its type.
+   */
+  template <int Kind, class Event>
+  Binary_log_event *process(Event *ev)
+  {
+    if (!(Static_handled_events<Handler>::value & Kind))
+      return m_next.template process<Kind>(ev);
+    Binary_log_event *processed=
+      static_cast<Content_handler &>(m_handler).process_event(ev);
+    if (processed == ev)
+      return m_next.template process<Kind>(ev);
+    return processed ? m_next.dispatch(processed) : 0;
+  }
+
+  Binary_log_event *dispatch(Binary_log_event *ev)
+  {
+    return dispatch_static(*this, ev);
+  }
+
+  void set_injection_queue(Injection_queue *queue)
+  {
+    static_cast<Content_handler &>(m_handler).set_injection_queue(queue);
+    m_next.set_injection_queue(queue);
+  }
+
+private:
+  Handler m_handler;
+  Next m_next;
+};
+
+/**
+ * The chain of stages for up to eight handlers.
+ */
+template <class H1, class H2, class H3, class H4,
+          class H5, class H6, class H7, class H8>
+struct Static_chain
+{
+  typedef Static_stage<H1, typename Static_chain<H2, H3, H4, H5, H6, H7, H8,
+                                                 Static_stage_end>::type> type;
+};
+
+template <>
+struct Static_chain<Static_stage_end, Static_stage_end, Static_stage_end,
+                    Static_stage_end, Static_stage_end, Static_stage_end,
+                    Static_stage_end, Static_stage_end>
+{
+  typedef Static_stage_end type;
+};
+
+/**
+ * Stage N of a chain.
+ */
+template <class Stage, int N>
+struct Static_stage_at
+{
+  typedef Static_stage_at<typename Stage::next_type, N - 1> Rest;
+  typedef typename Rest::handler_type handler_type;
+  static handler_type &get(Stage &stage) { return Rest::get(stage.next()); }
+};
+
+template <class Stage>
+struct Static_stage_at<Stage, 0>
+{
+  typedef typename Stage::handler_type handler_type;
+  static handler_type &get(Stage &stage) { return stage.handler(); }
+};
+
+/**
+ * A pipeline of content handlers composed at compile time. It owns one
+ * handler of each type, in order, and works out the type of each event
+ * once instead of once per handler. A handler is only called for the
+ * overload groups in its handled_events, provided it names itself as its
+ * handled_events_class.
+ *
+ * The pipeline is itself a content handler, so it is added to
+ * Binary_log::content_handler_pipeline() like any other and may be
+ * combined with dynamically added handlers. Handlers may use the
+ * injection queue as usual.
+ *
+ * Example:
+ *   Static_pipeline<Table_index, Basic_transaction_parser, My_handler>
+ *     pipeline;
+ *   pipeline.handler<1>().set_mode(Basic_transaction_parser::STREAMING_MODE);
+ *   binlog.content_handler_pipeline()->push_back(&pipeline);
+ */
+template <class H1,
+          class H2= Static_stage_end, class H3= Static_stage_end,
+          class H4= Static_stage_end, class H5= Static_stage_end,
+          class H6= Static_stage_end, class H7= Static_stage_end,
+          class H8= Static_stage_end>
+class Static_pipeline : public Content_handler
+{
+public:
+  typedef typename Static_chain<H1, H2, H3, H4,
+                                H5, H6, H7, H8>::type Stages;
+
+  enum { handled_events= Stages::handled_events };
+  typedef Static_pipeline handled_events_class;
+
+  Static_pipeline()
+  {
+    subscribe_overloads(handled_events);
+  }
+
+  /**
+   * Handler number N, counting from 0.
+   */
+  template <int N>
+  typename Static_stage_at<Stages, N>::handler_type &handler()
+  {
+    return Static_stage_at<Stages, N>::get(m_stages);
+  }
+
+  Binary_log_event *process_event(Query_event *ev)
+  {
+    return process<HANDLES_QUERY>(ev);
+  }
+  Binary_log_event *process_event(Row_event *ev)
+  {
+    return process<HANDLES_ROWS>(ev);
+  }
+  Binary_log_event *process_event(Table_map_event *ev)
+  {
+    return process<HANDLES_TABLE_MAP>(ev);
+  }
+  Binary_log_event *process_event(Xid *ev)
+  {
+    return process<HANDLES_XID>(ev);
+  }
+  Binary_log_event *process_event(User_var_event *ev)
+  {
+    return process<HANDLES_USER_VAR>(ev);
+  }
+  Binary_log_event *process_event(Incident_event *ev)
+  {
+    return process<HANDLES_INCIDENT>(ev);
+  }
+  Binary_log_event *process_event(Rotate_event *ev)
+  {
+    return process<HANDLES_ROTATE>(ev);
+  }
+  Binary_log_event *process_event(Int_var_event *ev)
+  {
+    return process<HANDLES_OTHER>(static_cast<Binary_log_event *>(ev));
+  }
+  Binary_log_event *process_event(Binary_log_event *ev)
+  {
+    return process<HANDLES_OTHER>(ev);
+  }
+
+private:
+  template <int Kind, class Event>
+  Binary_log_event *process(Event *ev)
+  {
+    m_stages.set_injection_queue(get_injection_queue());
+    return m_stages.template process<Kind>(ev);
+  }
+
+  Stages m_stages;
+};
+
+} // end namespace mysql
+
+#endif	/* _STATIC_PIPELINE_H */
@@ -0,0 +1,79 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _TABLE_FILTER_H
+#define	_TABLE_FILTER_H
+
+#include <string>
+#include <vector>
+
+namespace mysql {
+namespace system {
+
+/**
+ * Include and exclude rules on database and table names. Patterns may use
+ * the wildcards of LIKE: '%' matches any number of characters and '_'
+ * matches one character; a backslash makes the next character literal.
+ *
+ * A table is allowed if no exclude rule matches it and, when there are
+ * include rules, at least one of them matches it. An empty filter allows
+ * every table.
+ *
+ * Example:
+ *   Table_filter filter;
+ *   filter.include("shop", "order%");
+ *   filter.exclude("shop", "order\\_archive");
+ */
+class Table_filter
+{
+public:
+  Table_filter() {}
+
+  void include(const std::string &db_pattern, const std::string &table_pattern);
+  void exclude(const std::string &db_pattern, const std::string &table_pattern);
+
+  bool empty() const { return m_include.empty() && m_exclude.empty(); }
+
+  bool allows(const std::string &db_name, const std::string &table_name) const;
+
+private:
+  struct Rule
+  {
+    std::string db_pattern;
+    std::string table_pattern;
+  };
+
+  static bool matches(const std::vector<Rule> &rules, const std::string &db_name,
+                      const std::string &table_name);
+
+  std::vector<Rule> m_include;
+  std::vector<Rule> m_exclude;
+};
+
+/**
+ * Match str against a pattern with the wildcards '%' and '_'.
+ */
+bool wild_match(const char *pattern, const char *pattern_end,
+                const char *str, const char *str_end);
+
+} // end namespace system
+} // end namespace mysql
+
+#endif	/* _TABLE_FILTER_H */
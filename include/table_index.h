@@ -27,23 +27,152 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 
 #ifndef TABLE_INDEX_H
 #define	TABLE_INDEX_H
-#include "binlog_event.h"
+#include <stdint.h>
 #include <map>
+#include <string>
+#include <vector>
+#include "binlog_event.h"
 #include "basic_content_handler.h"
+#include "decode_plan.h"
+#include "ref_counted.h"
 
-typedef std::pair<uint64_t, mysql::Table_map_event *> Event_index_element;
-typedef std::map<uint64_t, mysql::Table_map_event *> Int2event_map;
+namespace mysql {
 
-class Table_index : public mysql::Content_handler, public Int2event_map
+/**
+ * The definition of a table as given by its table map events, decoded
+ * once: the column types, one metadata value per column and the plan for
+ * decoding its rows.
+ *
+ * A schema is immutable. Take a reference to keep it beyond the next
+ * event processed by the Table_index.
+ */
+class Table_schema : public Ref_counted
 {
 public:
- mysql::Binary_log_event *process_event(mysql::Table_map_event *tm);
+  Table_schema(const Table_map_event *table_map, uint64_t version);
+
+  /**
+   * True if the table map is for the same table with the same columns.
+   */
+  bool matches(const Table_map_event *table_map) const;
+
+  uint64_t table_id() const { return m_table_id; }
+  const std::string &db_name() const { return m_db_name; }
+  const std::string &table_name() const { return m_table_name; }
+
+  /**
+   * Counts up every time the index learns a new definition, whether of a
+   * new table or of a changed one.
+   */
+  uint64_t version() const { return m_version; }
+
+  size_t column_count() const { return m_columns.size(); }
+  /** The enum_field_types of column col_no as sent by the server */
+  uint8_t column_type(size_t col_no) const { return m_columns[col_no]; }
+  /** The metadata of column col_no, parsed from the packed array */
+  uint32_t column_metadata(size_t col_no) const
+  {
+    return m_plan->column(col_no).metadata;
+  }
+  bool is_nullable(size_t col_no) const
+  {
+    return col_no / 8 < m_null_bits.size() &&
+           (m_null_bits[col_no / 8] & (1 << (col_no & 7))) != 0;
+  }
+
+  /** Decodes rows of the table, e.g. with Row_index */
+  const Decode_plan *decode_plan() const { return m_plan; }
+
+protected:
+  ~Table_schema();
+
+private:
+  uint64_t m_table_id;
+  std::string m_db_name;
+  std::string m_table_name;
+  uint64_t m_version;
+  std::vector<uint8_t> m_columns;
+  std::vector<uint8_t> m_null_bits;
+  Decode_plan *m_plan;
+};
+
+/**
+ * A content handler which keeps the schema of every table seen in a table
+ * map event, by table id, for as long as it is valid. Table map events
+ * are passed on with the cached decode plan attached.
+ *
+ * An entry is replaced when its table id is mapped to another table or
+ * to changed columns, and dropped when a DDL statement (ALTER, CREATE,
+ * DROP, RENAME or TRUNCATE) names its table; a DDL statement whose
+ * tables can't be told drops every entry of its database, or all
+ * entries.
+ *
+ * Add the index ahead of a Basic_transaction_parser in the pipeline so
+ * that it sees the table maps before they are grouped into transactions,
+ * and don't mask out QUERY_EVENT.
+ *
+ * Example:
+ *   Table_index tables;
+ *   binlog.content_handler_pipeline()->push_front(&tables);
+ *   ...
+ *   const Table_schema *schema= tables.find(row_event->table_id);
+ *   if (schema)
+ *   {
+ *     Row_index rows(row_event, schema->decode_plan());
+ *     ...
+ *   }
+ *
+ * The index isn't thread safe. With Binary_log::set_threaded() it
+ * changes in a thread of its own while the consumer is still handling
+ * earlier events, so find(), get_table_name() and size() may then only
+ * be called in that thread, e.g. by a handler which follows the index
+ * in the same Static_pipeline. The consumer uses the decode plan
+ * attached to the table map events instead.
+ */
+class Table_index : public Content_handler
+{
+public:
+  Table_index();
+  ~Table_index();
+
+  enum { handled_events= HANDLES_QUERY | HANDLES_TABLE_MAP };
+  typedef Table_index handled_events_class;
+
+  mysql::Binary_log_event *process_event(mysql::Table_map_event *tm);
+  mysql::Binary_log_event *process_event(mysql::Query_event *qev);
+
+  /**
+   * The schema of a table, or 0 if the table id isn't known. The pointer
+   * is valid until the next event is processed unless a reference is
+   * taken. See above for threaded pipelines.
+   */
+  const Table_schema *find(uint64_t table_id) const;
+
+  /**
+   * Get the name of a table as "db.table".
+   *
+   * @retval 0 Success
+   * @retval 1 The table id isn't known
+   */
+  int get_table_name(uint64_t table_id, std::string &out) const;
+
+  size_t size() const { return m_schemas.size(); }
 
- ~Table_index();
+  /**
+   * Drop the entries of a table. Names are compared without regard to
+   * case; an empty table name drops every table of the database.
+   */
+  void invalidate(const std::string &db_name, const std::string &table_name);
 
- int get_table_name(int table_id, std::string out);
+  /** Drop all entries */
+  void clear();
 
+private:
+  typedef std::map<uint64_t, Table_schema *> Schema_map;
+  Schema_map m_schemas;
+  uint64_t m_version;
 };
 
+} // end namespace mysql
 
 #endif	/* TABLE_INDEX_H */
@@ -26,10 +26,14 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 #include <functional>
 
 #include "binlog_driver.h"
-#include "bounded_buffer.h"
+#include "spsc_queue.h"
 #include "protocol.h"
 
 #define MAX_PACKAGE_SIZE 0xffffff
+#define EVENT_QUEUE_SIZE 256
+#define RECV_BUFFER_SIZE (256 * 1024)
+#define RECV_POOL_SIZE 16
+#define RECV_LOW_WATER 4096
 
 using asio::ip::tcp;
 
@@ -47,15 +51,22 @@ public:
     Binlog_tcp_driver(const std::string& user, const std::string& passwd,
                       const std::string& host, unsigned long port)
       : Binary_log_driver("", 4), m_host(host), m_user(user), m_passwd(passwd),
-        m_port(port), m_socket(NULL), m_waiting_event(0), m_event_loop(0),
+        m_port(port), m_socket(NULL), m_event_loop(0), m_event_loop_done(0),
         m_total_bytes_transferred(0), m_shutdown(false),
-        m_event_queue(new bounded_buffer<Binary_log_event *>(50))
+        m_recv_pool(new Event_buffer_pool(RECV_BUFFER_SIZE, RECV_POOL_SIZE)),
+        m_recv_block(m_recv_pool->get()), m_recv_begin(0), m_recv_end(0),
+        m_event_block(0), m_event_size(0), m_skip_packets(false),
+        m_event_queue(new spsc_queue<Binary_log_event *>(EVENT_QUEUE_SIZE))
     {
     }
 
     ~Binlog_tcp_driver()
     {
         delete m_event_queue;
+        m_recv_block->release();
+        if (m_event_block)
+          m_event_block->release();
+        m_recv_pool->release();
         delete m_socket;
         free(this->thread_data);
     }
@@ -77,6 +88,9 @@ public:
 
     int get_position(std::string *str, unsigned long *position);
 
+    void interrupt() { m_event_queue->close(); }
+    void resume() { m_event_queue->reopen(); }
+
     const std::string& user() const { return m_user; }
     const std::string& password() const { return m_passwd; }
     const std::string& host() const { return m_host; }
@@ -113,37 +127,44 @@ private:
     void start_binlog_dump(const std::string &binlog_file_name, size_t offset);
 
     /**
-     * Handles a completed mysql server package header and put a
-     * request for the body in the job queue.
+     * Handles a completed read of up to RECV_BUFFER_SIZE bytes from the
+     * server. Every complete mysql packet in the receive buffer is handed
+     * to handle_net_packet() before the next read is posted, so a single
+     * completion can deliver many small binlog events.
+     *
+     * Parsed events refer into the receive block, so the bytes of handled
+     * packages are never overwritten while an event may still use them.
+     * When the block runs out of space the trailing partial package is
+     * copied to a fresh block from m_recv_pool; only when nothing refers to
+     * the current block any more is the partial package moved to its front
+     * instead.
      */
-    void handle_net_packet_header(const asio::error_code& err, std::size_t bytes_transferred);
+    void handle_net_read(const asio::error_code& err, std::size_t bytes_transferred);
 
     /**
-     * Handles a completed network package with the assumption that it contains
-     * a binlog event.
+     * Handles one complete network package with the assumption that it
+     * contains a binlog event. Events larger than MAX_PACKAGE_SIZE are split
+     * by the server over several packages; these are accumulated in
+     * m_event_block until the last package arrives.
      *
-     * TODO rename to handle_event_log_packet?
+     * @param packet The package payload, excluding the package header
+     * @param packet_length The size of the payload
      */
-    void handle_net_packet(const asio::error_code& err, std::size_t bytes_transferred);
+    void handle_net_packet(const char *packet, std::size_t packet_length);
 
     /**
-     * Called from handle_net_packet(). The function handle a stream of bytes
-     * representing event packets which may or may not be complete.
-     * It uses m_waiting_event and the size of the stream as parameters
-     * in a state machine. If there is no m_waiting_event then the event
-     * header must be parsed for the event packet length. This can only
-     * be done if the accumulated stream of bytes are more than 19.
-     * Next, if there is a m_waiting_event, it can only be completed if
-     * event_length bytes are waiting on the stream.
-     *
-     * If none of these conditions are fullfilled, the function exits without
-     * any action.
-     *
-     * @param err Not used
-     * @param bytes_transferred The number of bytes waiting in the event stream
+     * Parses a complete event package and puts the event on the event queue.
+     * An error package from the server is turned into an incident event.
      *
+     * @param owner The buffer which holds the package
      */
-    void handle_event_packet(const asio::error_code& err, std::size_t bytes_transferred);
+    void handle_event_packet(const char *packet, std::size_t packet_length,
+                             Event_buffer *owner);
+
+    /**
+     * Post an asynchronous read which appends to the receive buffer.
+     */
+    void post_net_read(void);
 
     /**
      * Executes io_service in a loop.
@@ -160,10 +181,23 @@ private:
     /**
      * Disconnet from the server. The io service must have been stopped before
      * this function is called.
-     * The event queue is emptied.
+     * The event queue is left untouched since it may only be drained from
+     * the consumer side; see drain_event_queue().
      */
     void disconnect(void);
 
+    /**
+     * Discard the content of the receive block. Reading starts over in a
+     * fresh block if events still refer to the current one.
+     */
+    void reset_recv_block(void);
+
+    /**
+     * Delete all events which haven't been fetched by the user application.
+     * Must only be called by the consumer of the event queue.
+     */
+    void drain_event_queue(void);
+
     /**
      * Terminates the io service and sets the shudown flag.
      * this causes the event loop to terminate.
@@ -171,6 +205,8 @@ private:
     void shutdown(void);
 
     pthread_t *m_event_loop;
+    /** Set by the event loop thread when it is about to return */
+    int m_event_loop_done;
     asio::io_service m_io_service;
     tcp::socket *m_socket;
     bool m_shutdown;
@@ -191,36 +227,40 @@ private:
     st_error_package m_error_package;
 
     /**
-     * each bin log event starts with a 19 byte long header
-     * We use this sturcture every time we initiate an async
-     * read.
+     * Recycles the receive blocks once all events referring to them have
+     * been deleted.
      */
-    uint8_t m_event_header[19];
+    Event_buffer_pool *m_recv_pool;
 
     /**
-     *
+     * Receive block for the async reads. The bytes between m_recv_begin
+     * and m_recv_end have been received but not yet handled; they are
+     * always the beginning of a package. A package which doesn't fit in a
+     * pool block gets a block of its own.
      */
-    uint8_t m_net_header[4];
+    Event_buffer *m_recv_block;
+    std::size_t m_recv_begin;
+    std::size_t m_recv_end;
 
     /**
-     *
+     * Accumulates the packages of an event which is larger than
+     * MAX_PACKAGE_SIZE.
      */
-    uint8_t m_net_packet[MAX_PACKAGE_SIZE];
-    asio::streambuf m_event_stream_buffer;
-    char * m_event_packet;
-
+    Event_buffer *m_event_block;
+    std::size_t m_event_size;
     /**
-     * This pointer points to an object constructed from event
-     * stream during async communication with
-     * server. If it is 0 it means that no event has been
-     * constructed yet.
+     * True while the remaining packages of an event which isn't
+     * subscribed are dropped.
      */
-    Log_event_header *m_waiting_event;
+    bool m_skip_packets;
+
     Log_event_header m_log_event_header;
     /**
-     * A ring buffer used to dispatch aggregated events to the user application
+     * A lock-free ring buffer used to dispatch aggregated events to the user
+     * application. The event loop thread is the only producer and the thread
+     * calling wait_for_next_event() the only consumer.
      */
-    bounded_buffer<Binary_log_event *> *m_event_queue;
+    spsc_queue<Binary_log_event *> *m_event_queue;
 
     std::string m_user;
     std::string m_host;
@@ -0,0 +1,150 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#ifndef _THREADED_PIPELINE_H
+#define	_THREADED_PIPELINE_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <list>
+#include <vector>
+
+#include "binlog_event.h"
+#include "binlog_driver.h"
+#include "basic_content_handler.h"
+#include "spsc_queue.h"
+
+/* The default capacity of the queues between threaded pipeline stages */
+#define PIPELINE_QUEUE_SIZE 256
+
+namespace mysql {
+
+/**
+ * An event on its way between two threads of a Threaded_pipeline, or the
+ * error which ended the stream.
+ */
+struct Pipeline_item
+{
+  Binary_log_event *event;
+  int error;
+};
+
+/**
+ * Runs a pipeline of content handlers with one thread per handler and one
+ * more reading from the driver. The threads are connected by bounded
+ * spsc_queues, so events leave the pipeline in the order they were read.
+ *
+ * A handler only sees events in its thread and may use the injection
+ * queue as usual. Its state is changed in that thread, ahead of the
+ * events the consumer is handling, so the consumer must not read it
+ * unless the handler synchronizes access itself; pass what the consumer
+ * needs on with the events instead. An injected event is processed right after the event
+ * during which it was injected, starting over at the handler which
+ * injected it rather than at the first one; the handlers before it have
+ * already moved on to later events.
+ *
+ * Used by Binary_log; see Binary_log::set_threaded().
+ */
+class Threaded_pipeline
+{
+public:
+  Threaded_pipeline(system::Binary_log_driver *driver,
+                    const std::vector<Content_handler *> &handlers,
+                    size_t queue_size= PIPELINE_QUEUE_SIZE);
+
+  /** Stops the threads */
+  ~Threaded_pipeline();
+
+  /**
+   * Start the threads.
+   *
+   * @retval 0 Success
+   * @retval 1 A thread couldn't be created; no thread is running
+   */
+  int start();
+
+  /**
+   * Stop the threads and release the events which were read but not
+   * returned yet.
+   */
+  void stop();
+
+  /**
+   * Stop reading from the driver, let the handlers process the events
+   * already read and stop the threads. The events coming out of the last
+   * handler are appended to events, so none is lost; the driver is left
+   * at the first event not read. An error of the driver meanwhile is
+   * dropped, the driver reports it again on the next read.
+   */
+  void drain(std::list<Binary_log_event *> &events);
+
+  bool is_running() const { return m_running; }
+
+  /**
+   * Wait for the next event to come out of the last handler.
+   *
+   * @return ERR_OK or the error of the driver which ended the stream
+   */
+  int wait_for_next_event(Binary_log_event **event);
+
+private:
+  Threaded_pipeline(const Threaded_pipeline&);              // Disabled copy constructor
+  Threaded_pipeline& operator = (const Threaded_pipeline&); // Disabled assign operator
+
+  typedef spsc_queue<Pipeline_item> Item_queue;
+
+  struct Stage
+  {
+    Threaded_pipeline *pipeline;
+    Content_handler *handler;
+    /** The subscribed events of the handler, read once */
+    system::Event_type_mask events;
+    Item_queue *input;
+    Item_queue *output;
+  };
+
+  static void *run_reader(void *arg);
+  static void *run_stage(void *arg);
+  bool process(Stage *stage, Binary_log_event *event);
+  bool stopping() const
+  {
+    return __atomic_load_n(&m_stopping, __ATOMIC_ACQUIRE) != 0;
+  }
+  bool draining() const
+  {
+    return __atomic_load_n(&m_draining, __ATOMIC_ACQUIRE) != 0;
+  }
+
+  system::Binary_log_driver *m_driver;
+  std::vector<Stage> m_stages;
+  /** The queue after the reader and after every stage */
+  std::vector<Item_queue *> m_queues;
+  std::vector<pthread_t> m_threads;
+  bool m_running;
+  int m_stopping;
+  /** Set by drain(); the reader ends the stream instead of reading on */
+  int m_draining;
+  /** The error which ended the stream, once the consumer got to it */
+  int m_error;
+};
+
+} // end namespace mysql
+
+#endif	/* _THREADED_PIPELINE_H */
@@ -62,6 +62,17 @@ public:
       //std::cout << "TYPE: " << type << " SIZE: " << m_size << std::endl;
     };
 
+    /**
+     * Construct a value whose size is already known, for example from a
+     * Decode_plan.
+     */
+    Value(enum system::enum_field_types type, uint32_t metadata,
+          const char *storage, size_t size, bool is_null) :
+      m_type(type), m_size(size), m_storage(storage), m_metadata(metadata),
+      m_is_null(is_null)
+    {
+    }
+
     Value()
     {
       m_size= 0;
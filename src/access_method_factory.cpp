@@ -20,11 +20,16 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 #include "access_method_factory.h"
 #include "tcp_driver.h"
 #include "file_driver.h"
+#include "mmap_driver.h"
+#include "multi_file_driver.h"
+#include <sys/stat.h>
 #include <unistd.h>
 
 using mysql::system::Binary_log_driver;
 using mysql::system::Binlog_tcp_driver;
 using mysql::system::Binlog_file_driver;
+using mysql::system::Binlog_mmap_driver;
+using mysql::system::Binlog_multi_file_driver;
 
 /**
    Parse the body of a MySQL URI.
@@ -82,10 +87,18 @@ static Binary_log_driver *parse_mysql_url(const char *body, size_t len)
 }
 
 
-static Binary_log_driver *parse_file_url(const char *body, size_t length)
+/**
+   Find the file name in the body of a file URI.
+
+   The format is <code>//path</code>, where path is absolute, or just the
+   name of a readable file.
+
+   @return The file name or 0
+*/
+static const char *file_url_path(const char *body)
 {
   if (access(body, R_OK) == 0)
-    return new Binlog_file_driver(body);
+    return body;
 
   /* Find the beginning of the file name */
   if (strncmp(body, "//", 2) != 0)
@@ -98,7 +111,43 @@ static Binary_log_driver *parse_file_url(const char *body, size_t length)
   if (body[2] != '/')
     return 0;
 
-  return new Binlog_file_driver(body + 2);
+  return body + 2;
+}
+
+
+/**
+   True if path names a directory of binlog files or a binlog index file,
+   which are read with a Binlog_multi_file_driver.
+*/
+static bool is_binlog_sequence(const char *path)
+{
+  struct stat stat_buff;
+  if (stat(path, &stat_buff) == 0 && S_ISDIR(stat_buff.st_mode))
+    return true;
+  size_t length= strlen(path);
+  return length > 6 && strcmp(path + length - 6, ".index") == 0;
+}
+
+
+static Binary_log_driver *parse_file_url(const char *body, size_t length)
+{
+  const char *path= file_url_path(body);
+  if (path == 0)
+    return 0;
+  if (is_binlog_sequence(path))
+    return new Binlog_multi_file_driver(path);
+  return new Binlog_file_driver(path);
+}
+
+
+static Binary_log_driver *parse_mmap_url(const char *body, size_t)
+{
+  const char *path= file_url_path(body);
+  if (path == 0)
+    return 0;
+  if (is_binlog_sequence(path))
+    return new Binlog_multi_file_driver(path);
+  return new Binlog_mmap_driver(path);
 }
 
 /**
@@ -115,6 +164,7 @@ struct Parser {
 static Parser url_parser[] = {
   { "mysql", parse_mysql_url },
   { "file",  parse_file_url },
+  { "mmap",  parse_mmap_url },
 };
 
 Binary_log_driver *
@@ -0,0 +1,64 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#include <algorithm>
+
+#include "arena.h"
+
+namespace mysql {
+
+Arena::Arena(size_t block_size)
+  : m_ptr(0), m_end(0), m_block_size(block_size), m_capacity(0)
+{
+}
+
+Arena::~Arena()
+{
+  clear();
+}
+
+void Arena::clear()
+{
+  for (std::vector<char *>::iterator it= m_blocks.begin();
+       it != m_blocks.end(); ++it)
+    delete [] *it;
+  m_blocks.clear();
+  m_ptr= m_end= 0;
+  m_capacity= 0;
+}
+
+void *Arena::allocate_block(size_t size)
+{
+  /*
+    Blocks grow so that a large transaction needs few of them. An
+    allocation larger than a block gets a block of its own.
+  */
+  if (!m_blocks.empty() && m_block_size < ARENA_MAX_BLOCK_SIZE)
+    m_block_size*= 2;
+  size_t block_size= std::max(size, m_block_size);
+  char *block= new char[block_size];
+  m_blocks.push_back(block);
+  m_capacity+= block_size;
+  m_ptr= block + size;
+  m_end= block + block_size;
+  return block;
+}
+
+} // end namespace mysql
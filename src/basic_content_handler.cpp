@@ -21,7 +21,19 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 
 namespace mysql {
 
-Content_handler::Content_handler () {}
+Content_handler::Content_handler ()
+  : m_reinject_queue(0), m_overloads_class(0)
+{
+  m_subscribed_events.set();
+}
+
+Content_handler::Content_handler(const mysql::Content_handler& orig)
+  : m_reinject_queue(0), m_subscribed_events(orig.m_subscribed_events),
+    m_overload_events(orig.m_overload_events),
+    m_overloads_class(orig.m_overloads_class)
+{
+}
+
 Content_handler::~Content_handler () {}
 mysql::Binary_log_event *Content_handler::process_event(mysql::Query_event *ev) { return ev; }
 mysql::Binary_log_event *Content_handler::process_event(mysql::Row_event *ev) { return ev; }
@@ -33,6 +45,57 @@ mysql::Binary_log_event *Content_handler::process_event(mysql::Rotate_event *ev)
 mysql::Binary_log_event *Content_handler::process_event(mysql::Int_var_event *ev) { return ev; }
 mysql::Binary_log_event *Content_handler::process_event(mysql::Binary_log_event *ev) { return ev; }
 
+void Content_handler::subscribe_overloads(int handled)
+{
+  system::Event_type_mask types;
+  if (handled & HANDLES_OTHER)
+  {
+    /* Everything except the types with an overload of their own */
+    types.set();
+    types.reset(QUERY_EVENT);
+    types.reset(WRITE_ROWS_EVENT);
+    types.reset(UPDATE_ROWS_EVENT);
+    types.reset(DELETE_ROWS_EVENT);
+    types.reset(TABLE_MAP_EVENT);
+    types.reset(XID_EVENT);
+    types.reset(USER_VAR_EVENT);
+    types.reset(INCIDENT_EVENT);
+    types.reset(ROTATE_EVENT);
+  }
+  if (handled & HANDLES_QUERY)
+    types.set(QUERY_EVENT);
+  if (handled & HANDLES_ROWS)
+  {
+    types.set(WRITE_ROWS_EVENT);
+    types.set(UPDATE_ROWS_EVENT);
+    types.set(DELETE_ROWS_EVENT);
+  }
+  if (handled & HANDLES_TABLE_MAP)
+    types.set(TABLE_MAP_EVENT);
+  if (handled & HANDLES_XID)
+    types.set(XID_EVENT);
+  if (handled & HANDLES_USER_VAR)
+    types.set(USER_VAR_EVENT);
+  if (handled & HANDLES_INCIDENT)
+    types.set(INCIDENT_EVENT);
+  if (handled & HANDLES_ROTATE)
+    types.set(ROTATE_EVENT);
+  m_overload_events= types;
+  /* In a constructor this is the class being constructed */
+  m_overloads_class= &typeid(*this);
+}
+
+const system::Event_type_mask &Content_handler::subscribed_events() const
+{
+  /*
+    A derived class may override overloads which the class that narrowed
+    the subscription left out.
+  */
+  if (m_overloads_class && typeid(*this) == *m_overloads_class)
+    return m_overload_events;
+  return m_subscribed_events;
+}
+
 Injection_queue *Content_handler::get_injection_queue(void)
 {
   return m_reinject_queue;
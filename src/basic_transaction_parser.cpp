@@ -19,11 +19,16 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 */
 
 #include <iostream>
+#include <algorithm>
+#include <stdlib.h>
+#include <unistd.h>
 #include "binlog_event.h"
 #include "basic_transaction_parser.h"
+#include "event_pool.h"
 #include "protocol.h"
 #include "value.h"
 #include "field_iterator.h"
+#include "logging.h"
 
 namespace mysql {
 
@@ -52,7 +57,15 @@ mysql::Binary_log_event *Basic_transaction_parser::process_event(mysql::Table_ma
 {
   if(m_transaction_state ==IN_PROGRESS)
   {
-    m_event_stack.push_back(ev);
+    if (m_streaming)
+    {
+      ev->transaction_seq_no= m_seq_no;
+      return ev;
+    }
+    /*
+     Index the table name with a table id to ease lookup later.
+    */
+    add_event(ev);
     return 0;
   }
   return ev;
@@ -62,7 +75,16 @@ mysql::Binary_log_event *Basic_transaction_parser::process_event(mysql::Row_even
 {
   if(m_transaction_state ==IN_PROGRESS)
   {
-    m_event_stack.push_back(ev);
+    if (m_streaming)
+    {
+      ev->transaction_seq_no= m_seq_no;
+      return ev;
+    }
+    /*
+     * Propagate last known next position
+     */
+    m_transaction->header()->next_position= ev->header()->next_position;
+    add_event(ev);
     return 0;
   }
   return ev;
@@ -75,56 +97,73 @@ mysql::Binary_log_event *Basic_transaction_parser::process_transaction_state(mys
     case STARTING:
     {
       m_transaction_state= IN_PROGRESS;
-      m_start_time= incomming_event->header()->timestamp;
-      delete incomming_event; // drop the begin event
+      if (m_streaming)
+      {
+        release_event(incomming_event);
+        return 0;
+      }
+      if (m_transaction == 0)
+      {
+        ++m_seq_no;
+        m_start_time= incomming_event->header()->timestamp;
+        if (m_mode == STREAMING_MODE)
+        {
+          /* Replace the begin event with a marker */
+          m_streaming= true;
+          Transaction_marker_event *begin=
+            create_marker(TRANSACTION_BEGIN_EVENT, incomming_event);
+          release_event(incomming_event);
+          return begin;
+        }
+        m_transaction= mysql::create_transaction_log_event();
+        m_transaction->seq_no= m_seq_no;
+      }
+      release_event(incomming_event); // drop the begin event
       return 0;
     }
     case COMMITTING:
     {
-      delete incomming_event; // drop the commit event
+      if (m_streaming)
+      {
+        Transaction_marker_event *commit=
+          create_marker(TRANSACTION_COMMIT_EVENT, incomming_event);
+        if (incomming_event->get_event_type() == XID_EVENT)
+        {
+          commit->xid= static_cast<Xid *>(incomming_event)->xid_id;
+          commit->has_xid= true;
+        }
+        release_event(incomming_event);
+        m_streaming= false;
+        m_transaction_state= NOT_IN_PROGRESS;
+        return commit;
+      }
+
+      mysql::Transaction_log_event *trans= m_transaction;
+      if (trans == 0)
+        trans= mysql::create_transaction_log_event();
+      m_transaction= 0;
+
+      /* The transaction ends where its commit event ends */
+      trans->header()->next_position= incomming_event->header()->next_position;
+      release_event(incomming_event); // drop the commit event
+      trans->flush();
+      m_transaction_state= NOT_IN_PROGRESS;
+
+      /* Never pass on a transaction with events missing */
+      if (trans->has_lost_events())
+      {
+        unsigned long next_position= trans->header()->next_position;
+        release_event(trans);
+        return create_incident_event(175, "Lost the events of a transaction "
+                                     "which couldn't be spilled",
+                                     next_position);
+      }
 
       /**
-       * Propagate the start time for the transaction to the newly created
+       * Propagate the start time for the transaction to the transaction
        * event.
        */
-      mysql::Transaction_log_event *trans=  mysql::create_transaction_log_event();
       trans->header()->timestamp= m_start_time;
-
-      //std::cout << "There are " << m_event_stack.size() << " events in the transaction: ";
-      while( m_event_stack.size() > 0)
-      {
-        mysql::Binary_log_event *event= m_event_stack.front();
-        m_event_stack.pop_front();
-        switch(event->get_event_type())
-        {
-          case mysql::TABLE_MAP_EVENT:
-          {
-            /*
-             Index the table name with a table id to ease lookup later.
-            */
-            mysql::Table_map_event *tm= static_cast<mysql::Table_map_event *>(event);
-            //std::cout << "Indexing table " << tm->table_id << " " << tm->table_name << std::endl;
-            //std::cout.flush ();
-            trans->m_table_map.insert(mysql::Event_index_element(tm->table_id,tm));
-            trans->m_events.push_back(event);
-          }
-          break;
-          case mysql::WRITE_ROWS_EVENT:
-          case mysql::DELETE_ROWS_EVENT:
-          case mysql::UPDATE_ROWS_EVENT:
-          {
-            trans->m_events.push_back(event);
-             /*
-             * Propagate last known next position
-             */
-            trans->header()->next_position= event->header()->next_position;
-          }
-          break;
-          default:
-            delete event;
-         }
-      } // end while
-      m_transaction_state= NOT_IN_PROGRESS;
       return(trans);
     }
     case NOT_IN_PROGRESS:
@@ -134,6 +173,58 @@ mysql::Binary_log_event *Basic_transaction_parser::process_transaction_state(mys
 
 }
 
+Transaction_marker_event *
+Basic_transaction_parser::create_marker(Log_event_type type,
+                                        mysql::Binary_log_event *source)
+{
+  Log_event_header header= *source->header();
+  header.type_code= type;
+  Transaction_marker_event *marker= new Transaction_marker_event(&header);
+  marker->seq_no= m_seq_no;
+  marker->start_time= m_start_time;
+  return marker;
+}
+
+void Basic_transaction_parser::start_streaming()
+{
+  Injection_queue *queue= get_injection_queue();
+  Event_list &events= m_transaction->m_events;
+
+  /*
+    The buffered events come back through the content handlers after the
+    begin marker and are then passed on since the transaction is streamed.
+  */
+  queue->push_back(create_marker(TRANSACTION_BEGIN_EVENT, events.front()));
+  queue->insert(queue->end(), events.begin(), events.end());
+  events.clear();
+  m_transaction->m_table_map.clear();
+  release_event(m_transaction);
+  m_transaction= 0;
+  m_streaming= true;
+}
+
+void Basic_transaction_parser::add_event(mysql::Binary_log_event *ev)
+{
+  m_transaction->add_event(ev);
+  if (m_mode == ADAPTIVE_MODE && get_injection_queue() != 0 &&
+      !m_transaction->is_spilled() &&
+      m_transaction->memory_size() > m_streaming_threshold)
+  {
+    start_streaming();
+    return;
+  }
+  if (m_memory_budget > 0 && !m_transaction->is_spilled() &&
+      !m_transaction->spill_failed() &&
+      m_transaction->memory_size() > m_memory_budget)
+    m_transaction->spill(m_spill_directory);
+}
+
+Basic_transaction_parser::~Basic_transaction_parser()
+{
+  /* Drop an unfinished transaction */
+  release_event(m_transaction);
+}
+
 Transaction_log_event *create_transaction_log_event(void)
 {
     Transaction_log_event *trans= new Transaction_log_event();
@@ -141,22 +232,279 @@ Transaction_log_event *create_transaction_log_event(void)
     return trans;
 };
 
+Transaction_log_event::Transaction_log_event()
+  : Binary_log_event(), m_table_map(std::less<uint64_t>(),
+                                    Arena_allocator<Event_index_element>(&m_arena)),
+    m_events(Arena_allocator<Binary_log_event *>(&m_arena)),
+    seq_no(0), m_event_count(0), m_memory_size(0), m_last_buffer(0),
+    m_spill_file(0),
+    m_spill_size(0), m_spill_failed(false)
+{
+}
+
+Transaction_log_event::Transaction_log_event(Log_event_header *header)
+  : Binary_log_event(header),
+    m_table_map(std::less<uint64_t>(),
+                Arena_allocator<Event_index_element>(&m_arena)),
+    m_events(Arena_allocator<Binary_log_event *>(&m_arena)),
+    seq_no(0), m_event_count(0), m_memory_size(0), m_last_buffer(0),
+    m_spill_file(0),
+    m_spill_size(0), m_spill_failed(false)
+{
+}
+
 Transaction_log_event::~Transaction_log_event()
 {
-  Int_to_Event_map::iterator it;
-  for(it = m_table_map.begin(); it != m_table_map.end();)
+  /* The nodes of the list and the index are freed with the arena */
+  release_events();
+  if (m_spill_file)
+    fclose(m_spill_file);
+}
+
+void Transaction_log_event::release_events()
+{
+  /*
+    The events come from the pool of the driver, which they go back to
+    in bulk, rather than taking the pool lock once per event.
+  */
+  size_t count= m_events.size();
+  if (count == 0)
+    return;
+  Binary_log_event **events= static_cast<Binary_log_event **>(
+    m_arena.allocate(count * sizeof(Binary_log_event *)));
+  std::copy(m_events.begin(), m_events.end(), events);
+  mysql::release_events(events, count);
+  m_events.clear();
+}
+
+void Transaction_log_event::add_event(Binary_log_event *event)
+{
+  ++m_event_count;
+  if (m_spill_file)
+  {
+    /* The file is useless once an event is missing from it */
+    if (!m_spill_failed && write_spilled(event))
+    {
+      MRL_ERROR("Can't write to the spill file of a transaction; "
+                "the transaction is dropped");
+      m_spill_failed= true;
+    }
+    release_event(event);
+    return;
+  }
+
+  if (event->get_event_type() == TABLE_MAP_EVENT)
   {
-    /* No need to delete the event here; it happens in the next iteration */
-    m_table_map.erase(it++);
+    Table_map_event *tm= static_cast<Table_map_event *>(event);
+    m_table_map.insert(Event_index_element(tm->table_id, tm));
   }
+  m_events.push_back(event);
+  m_memory_size+= held_size(event);
+}
+
+size_t Transaction_log_event::held_size(Binary_log_event *event)
+{
+  size_t size= event->header()->event_length;
+  Log_event_type type= event->get_event_type();
+  if (type != WRITE_ROWS_EVENT && type != UPDATE_ROWS_EVENT &&
+      type != DELETE_ROWS_EVENT)
+    return size;
 
-  while (m_events.size() > 0)
+  /*
+    The row images keep the whole buffer they refer into alive. Drivers
+    pack consecutive events into one buffer, so a buffer is counted when
+    the first event referring to it is added. A mapped file isn't counted
+    beyond the row images, as its pages can be dropped and read again.
+  */
+  const Event_payload &row= static_cast<Row_event *>(event)->row;
+  const Event_buffer *buffer= row.buffer();
+  if (buffer == 0 || !buffer->owns_data())
+    return size;
+  size-= std::min(size, row.size());
+  if (buffer != m_last_buffer)
   {
-    Binary_log_event *event= m_events.back();
-    m_events.pop_back();
-    delete(event);
+    m_last_buffer= buffer;
+    size+= buffer->capacity();
   }
+  return size;
+}
+
+int Transaction_log_event::write_spilled(Binary_log_event *event)
+{
+  m_spill_buffer.clear();
+  if (!system::proto_encode_event(m_spill_buffer, event))
+    return 1;
+  if (fwrite(&m_spill_buffer[0], 1, m_spill_buffer.size(), m_spill_file) !=
+      m_spill_buffer.size())
+    return 1;
+  m_spill_size+= m_spill_buffer.size();
+  return 0;
+}
 
+int Transaction_log_event::spill(const std::string &directory)
+{
+  std::string path= directory + "/mysql-transaction-XXXXXX";
+  std::vector<char> name(path.begin(), path.end());
+  name.push_back('\0');
+  int fd= mkstemp(&name[0]);
+  if (fd < 0)
+  {
+    MRL_ERROR("Can't create a spill file in " << directory);
+    m_spill_failed= true;
+    return 1;
+  }
+  /* The file disappears when it is closed */
+  unlink(&name[0]);
+  m_spill_file= fdopen(fd, "w+b");
+  if (m_spill_file == 0)
+  {
+    close(fd);
+    m_spill_failed= true;
+    return 1;
+  }
+
+  for (Event_list::iterator it= m_events.begin(); it != m_events.end(); ++it)
+  {
+    if (write_spilled(*it))
+    {
+      MRL_ERROR("Can't write to the spill file of a transaction");
+      fclose(m_spill_file);
+      m_spill_file= 0;
+      m_spill_size= 0;
+      m_spill_failed= true;
+      return 1;
+    }
+  }
+  MRL_DEBUG("Spilled a transaction of " << m_memory_size << " bytes");
+
+  release_events();
+  m_table_map.clear();
+  /* Nothing refers to the nodes in the arena any more */
+  m_arena.clear();
+  m_memory_size= 0;
+  m_last_buffer= 0;
+  return 0;
+}
+
+void Transaction_log_event::flush()
+{
+  if (m_spill_file && fflush(m_spill_file))
+  {
+    MRL_ERROR("Can't write to the spill file of a transaction");
+    m_spill_failed= true;
+  }
+}
+
+Transaction_event_reader::Transaction_event_reader(Transaction_log_event *trans)
+  : m_trans(trans), m_it(trans->m_events.begin()), m_offset(0), m_buffer(0),
+    m_buffer_used(0), m_current(0), m_error(false)
+{
+  trans->flush();
+}
+
+Transaction_event_reader::~Transaction_event_reader()
+{
+  release_event(m_current);
+  for (std::map<uint64_t, Table_map_event *>::iterator it= m_table_maps.begin();
+       it != m_table_maps.end(); ++it)
+    release_event(it->second);
+  if (m_buffer)
+    m_buffer->release();
+}
+
+Binary_log_event *Transaction_event_reader::next()
+{
+  release_event(m_current);
+  m_current= 0;
+
+  if (m_it != m_trans->m_events.end())
+    return *m_it++;
+  if (m_trans->m_spill_file == 0 || m_error)
+    return 0;
+  return read_spilled();
+}
+
+Binary_log_event *Transaction_event_reader::read_spilled()
+{
+  if (m_offset >= m_trans->m_spill_size)
+    return 0;
+
+  int fd= fileno(m_trans->m_spill_file);
+  char header_buf[LOG_EVENT_HEADER_SIZE - 1];
+  if (pread(fd, header_buf, sizeof(header_buf), m_offset) !=
+      (ssize_t) sizeof(header_buf))
+  {
+    m_error= true;
+    return 0;
+  }
+  Log_event_header header;
+  system::Buffer_decoder header_dec(header_buf, sizeof(header_buf));
+  system::proto_event_header(header_dec, &header);
+  if (header.event_length < sizeof(header_buf))
+  {
+    m_error= true;
+    return 0;
+  }
+
+  /*
+    Rows events refer to the buffer, and their row images may be kept
+    after the event is gone. The bodies are packed into the buffer one
+    after the other, as the file driver does, and the buffer is only
+    reused from its start once nothing refers to it.
+  */
+  size_t body_length= header.event_length - sizeof(header_buf);
+  if (m_buffer && m_buffer->is_unique())
+    m_buffer_used= 0;
+  if (m_buffer == 0 || m_buffer->capacity() - m_buffer_used < body_length)
+  {
+    if (m_buffer)
+      m_buffer->release();
+    m_buffer= new Event_buffer(std::max(body_length, (size_t) 64 * 1024));
+    m_buffer_used= 0;
+  }
+  char *body= m_buffer->data() + m_buffer_used;
+  if (pread(fd, body, body_length, m_offset + sizeof(header_buf)) !=
+      (ssize_t) body_length)
+  {
+    m_error= true;
+    return 0;
+  }
+  m_offset+= header.event_length;
+  m_buffer_used+= body_length;
+
+  system::Buffer_decoder dec(body, body_length, m_buffer);
+  if (header.type_code == TABLE_MAP_EVENT)
+  {
+    Table_map_event *tm= system::proto_table_map_event(dec, &header);
+    if (dec.overrun())
+    {
+      release_event(tm);
+      m_error= true;
+      return 0;
+    }
+    Table_map_event *&slot= m_table_maps[tm->table_id];
+    release_event(slot);
+    slot= tm;
+    return tm;
+  }
+  m_current= system::proto_rows_event(dec, &header);
+  if (dec.overrun())
+    m_error= true;
+  return m_error ? 0 : m_current;
+}
+
+Table_map_event *Transaction_event_reader::table_map(uint64_t table_id)
+{
+  if (m_trans->is_spilled())
+  {
+    std::map<uint64_t, Table_map_event *>::iterator it=
+      m_table_maps.find(table_id);
+    return it == m_table_maps.end() ? 0 : it->second;
+  }
+  Int_to_Event_map::iterator it= m_trans->m_table_map.find(table_id);
+  if (it == m_trans->m_table_map.end())
+    return 0;
+  return static_cast<Table_map_event *>(it->second);
 }
 
 } // end namespace
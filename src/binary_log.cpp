@@ -18,6 +18,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 02110-1301  USA
 */
 
+#include <algorithm>
 #include <list>
 
 #include "binlog_api.h"
@@ -27,7 +28,9 @@ using namespace mysql::system;
 
 namespace mysql
 {
-Binary_log::Binary_log(Binary_log_driver *drv) : m_binlog_position(4), m_binlog_file("")
+Binary_log::Binary_log(Binary_log_driver *drv)
+  : m_binlog_position(4), m_binlog_file(""), m_threads(0), m_threaded(false),
+    m_queue_size(PIPELINE_QUEUE_SIZE)
 {
   if (drv == NULL)
   {
@@ -37,6 +40,17 @@ Binary_log::Binary_log(Binary_log_driver *drv) : m_binlog_position(4), m_binlog_
    m_driver= drv;
 }
 
+Binary_log::~Binary_log()
+{
+  delete m_threads;
+  discard_drained_events();
+  while (!m_reinjection_queue.empty())
+  {
+    release_event(m_reinjection_queue.front());
+    m_reinjection_queue.pop_front();
+  }
+}
+
 Content_handler_pipeline *Binary_log::content_handler_pipeline(void)
 {
   return &m_content_handlers;
@@ -48,7 +62,17 @@ int Binary_log::wait_for_next_event(mysql::Binary_log_event **event_ptr)
   bool handler_code;
   mysql::Binary_log_event *event;
 
-  mysql::Injection_queue reinjection_queue;
+  /*
+    Injected events are kept between calls so that a content handler can
+    turn one event into several; they are returned one per call.
+  */
+  mysql::Injection_queue &reinjection_queue= m_reinjection_queue;
+
+  if (!m_drained_events.empty())
+    return next_drained_event(event_ptr);
+
+  if (m_threaded)
+    return wait_for_threaded_event(event_ptr);
 
   do {
     handler_code= false;
@@ -64,20 +88,30 @@ int Binary_log::wait_for_next_event(mysql::Binary_log_event **event_ptr)
         return rc;
     }
     m_binlog_position= event->header()->next_position;
-    mysql::Content_handler *handler;
+    update_dispatch();
 
-    for (std::list<Content_handler *>::iterator it = m_content_handlers.begin();
-            it != m_content_handlers.end();
-            it++) 
+    const std::vector<size_t> *handlers=
+      &m_dispatch[event->header()->type_code];
+    size_t i= 0;
+    while (event && i < handlers->size())
     {
-      handler = *it;
-      if (event)
+      size_t pos= (*handlers)[i];
+      mysql::Content_handler *handler= m_dispatch_handlers[pos];
+      unsigned int type= event->header()->type_code;
+      handler->set_injection_queue(&reinjection_queue);
+      event= handler->internal_process_event(event);
+
+      if (event && event->header()->type_code != type)
       {
-        handler->set_injection_queue(&reinjection_queue);
-        event= handler->internal_process_event(event);
+        /* Go on with the handlers after this one which want the new type */
+        handlers= &m_dispatch[event->header()->type_code];
+        i= std::upper_bound(handlers->begin(), handlers->end(), pos) -
+           handlers->begin();
       }
+      else
+        ++i;
     }
-  } while(event == 0 || !reinjection_queue.empty());
+  } while(event == 0);
 
   if (event_ptr)
     *event_ptr= event;
@@ -85,13 +119,136 @@ int Binary_log::wait_for_next_event(mysql::Binary_log_event **event_ptr)
   return 0;
 }
 
+int Binary_log::wait_for_threaded_event(mysql::Binary_log_event **event_ptr)
+{
+  if (update_dispatch() && m_threads)
+  {
+    /* The events on their way are finished by the handlers they met */
+    m_threads->drain(m_drained_events);
+    delete m_threads;
+    m_threads= 0;
+    if (!m_drained_events.empty())
+      return next_drained_event(event_ptr);
+  }
+  if (m_threads == 0)
+  {
+    /* The driver isn't ahead yet; from now on the file is followed */
+    if (m_binlog_file.empty() && m_drained_events.empty())
+      m_driver->get_position(&m_binlog_file, NULL);
+    m_threads= new Threaded_pipeline(m_driver, m_dispatch_handlers,
+                                     m_queue_size);
+  }
+  if (m_threads->start())
+    return ERR_FAIL;
+
+  mysql::Binary_log_event *event;
+  int rc= m_threads->wait_for_next_event(&event);
+  if (rc)
+  {
+    /* The next call starts over with the driver, as without threads */
+    m_threads->stop();
+    return rc;
+  }
+
+  advance_position(event);
+  if (event_ptr)
+    *event_ptr= event;
+  return ERR_OK;
+}
+
+int Binary_log::next_drained_event(mysql::Binary_log_event **event_ptr)
+{
+  mysql::Binary_log_event *event= m_drained_events.front();
+  m_drained_events.pop_front();
+  advance_position(event);
+  if (event_ptr)
+    *event_ptr= event;
+  return ERR_OK;
+}
+
+void Binary_log::advance_position(mysql::Binary_log_event *event)
+{
+  /*
+    A rotate event at the end of a file names the file of the events after
+    it. One without a position of its own comes from a server, or from a
+    driver moving on to another file, and tells where the stream goes on.
+  */
+  bool is_rotate= event->get_event_type() == ROTATE_EVENT;
+  if (is_rotate && event->header()->next_position == 0)
+  {
+    Rotate_event *rotate= static_cast<Rotate_event *>(event);
+    m_binlog_file= rotate->binlog_file;
+    m_binlog_position= rotate->binlog_pos;
+    m_next_binlog_file.clear();
+  }
+  else if (event->header()->next_position)
+  {
+    if (!m_next_binlog_file.empty())
+    {
+      m_binlog_file= m_next_binlog_file;
+      m_next_binlog_file.clear();
+    }
+    m_binlog_position= event->header()->next_position;
+    if (is_rotate)
+      m_next_binlog_file= static_cast<Rotate_event *>(event)->binlog_file;
+  }
+}
+
+void Binary_log::discard_drained_events()
+{
+  while (!m_drained_events.empty())
+  {
+    release_event(m_drained_events.front());
+    m_drained_events.pop_front();
+  }
+}
+
+void Binary_log::set_threaded(bool threaded, size_t queue_size)
+{
+  if (m_threads)
+    m_threads->drain(m_drained_events);
+  delete m_threads;
+  m_threads= 0;
+  m_threaded= threaded;
+  m_queue_size= queue_size;
+}
+
+bool Binary_log::update_dispatch()
+{
+  size_t pos= 0;
+  Content_handler_pipeline::iterator it= m_content_handlers.begin();
+  while (it != m_content_handlers.end() && pos < m_dispatch_handlers.size() &&
+         *it == m_dispatch_handlers[pos])
+  {
+    ++it;
+    ++pos;
+  }
+  if (it == m_content_handlers.end() && pos == m_dispatch_handlers.size())
+    return false;
+
+  m_dispatch_handlers.assign(m_content_handlers.begin(),
+                             m_content_handlers.end());
+  for (unsigned int type= 0; type < 256; ++type)
+  {
+    m_dispatch[type].clear();
+    for (pos= 0; pos < m_dispatch_handlers.size(); ++pos)
+      if (m_dispatch_handlers[pos]->subscribed_events().test(type))
+        m_dispatch[type].push_back(pos);
+  }
+  return true;
+}
+
 int Binary_log::set_position(const std::string &filename, unsigned long position)
 {
+  if (m_threads)
+    m_threads->stop();
+  discard_drained_events();
   int status= m_driver->set_position(filename, position);
   if (status == ERR_OK)
   {
     m_binlog_file= filename;
     m_binlog_position= position;
+    m_next_binlog_file.clear();
   }
   return status;
 }
@@ -99,7 +256,10 @@ int Binary_log::set_position(const std::string &filename, unsigned long position
 int Binary_log::set_position(unsigned long position)
 {
   std::string filename;
-  m_driver->get_position(&filename, NULL);
+  if (is_reading_ahead())
+    filename= m_binlog_file;
+  else
+    m_driver->get_position(&filename, NULL);
   return this->set_position(filename, position);
 }
 
@@ -110,13 +270,17 @@ unsigned long Binary_log::get_position(void)
 
 unsigned long Binary_log::get_position(std::string &filename)
 {
-  m_driver->get_position(&m_binlog_file, &m_binlog_position);
+  if (!is_reading_ahead())
+    m_driver->get_position(&m_binlog_file, &m_binlog_position);
   filename= m_binlog_file;
   return m_binlog_position;
 }
 
 int Binary_log::connect()
 {
+  if (m_threads)
+    m_threads->stop();
+  discard_drained_events();
   return m_driver->connect();
 }
 
@@ -22,52 +22,158 @@
 
 namespace mysql { namespace system {
 
+Binary_log_driver::~Binary_log_driver()
+{
+  for (Decode_plan_cache::iterator it= m_decode_plans.begin();
+       it != m_decode_plans.end(); ++it)
+    it->second->release();
+  m_event_pool->release();
+}
+
+void Binary_log_driver::attach_decode_plan(Table_map_event *table_map)
+{
+  Decode_plan_cache::iterator it= m_decode_plans.find(table_map->table_id);
+  if (it != m_decode_plans.end() && it->second->matches(table_map))
+  {
+    it->second->add_ref();
+    table_map->decode_plan= it->second;
+    return;
+  }
+
+  Decode_plan *plan= new Decode_plan(table_map);
+  if (it != m_decode_plans.end())
+  {
+    it->second->release();
+    it->second= plan;
+  }
+  else
+  {
+    if (m_decode_plans.size() >= DECODE_PLAN_CACHE_SIZE)
+    {
+      for (it= m_decode_plans.begin(); it != m_decode_plans.end(); ++it)
+        it->second->release();
+      m_decode_plans.clear();
+    }
+    m_decode_plans.insert(std::make_pair(table_map->table_id, plan));
+  }
+  plan->add_ref();
+  table_map->decode_plan= plan;
+}
+
+void Binary_log_driver::set_table_filter(const Table_filter &filter)
+{
+  m_table_filter= filter;
+  m_excluded_tables.clear();
+  m_evict_excluded= false;
+}
+
+bool Binary_log_driver::filter_table_map(const Table_map_event *table_map)
+{
+  if (m_table_filter.empty())
+    return true;
+  if (m_table_filter.allows(table_map->db_name, table_map->table_name))
+  {
+    /* The table id may have been reused by a table which is allowed */
+    m_excluded_tables.erase(table_map->table_id);
+    return true;
+  }
+  /*
+    Clearing the ids between the table maps and the rows events of a
+    statement would let the rows of an excluded table through, so it waits
+    for the end of the statement. Without rows events there is nothing to
+    let through.
+  */
+  if (m_excluded_tables.size() >= DECODE_PLAN_CACHE_SIZE)
+  {
+    if (is_subscribed(WRITE_ROWS_EVENT) || is_subscribed(UPDATE_ROWS_EVENT) ||
+        is_subscribed(DELETE_ROWS_EVENT))
+      m_evict_excluded= true;
+    else
+      m_excluded_tables.clear();
+  }
+  m_excluded_tables.insert(table_map->table_id);
+  return false;
+}
+
 /*
 Binary_log_event* Binary_log_driver::parse_event(asio::streambuf
                                                  &sbuff, Log_event_header
                                                  *header)
                                                  */
-Binary_log_event* Binary_log_driver::parse_event(std::istream &is,
+Binary_log_event* Binary_log_driver::parse_event(Buffer_decoder &dec,
                                                  Log_event_header *header)
 {
   Binary_log_event *parsed_event= 0;
 
+  if (!is_subscribed(header->type_code) ||
+      is_excluded_rows_event(header->type_code, dec.current(), dec.remaining()))
+    return 0;
+
   switch (header->type_code) {
     case TABLE_MAP_EVENT:
-      parsed_event= proto_table_map_event(is, header);
+      {
+        Table_map_event *tm= proto_table_map_event(dec, header, m_event_pool);
+        if (!dec.overrun())
+        {
+          if (!filter_table_map(tm))
+          {
+            release_event(tm);
+            return 0;
+          }
+          attach_decode_plan(tm);
+        }
+        parsed_event= tm;
+      }
       break;
     case QUERY_EVENT:
-      parsed_event= proto_query_event(is, header);
+      parsed_event= proto_query_event(dec, header, m_event_pool);
       break;
     case INCIDENT_EVENT:
-      parsed_event= proto_incident_event(is, header);
+      parsed_event= proto_incident_event(dec, header, m_event_pool);
       break;
     case WRITE_ROWS_EVENT:
     case UPDATE_ROWS_EVENT:
     case DELETE_ROWS_EVENT:
-      parsed_event= proto_rows_event(is, header);
+      parsed_event= proto_rows_event(dec, header, m_event_pool);
       break;
     case ROTATE_EVENT:
       {
-        Rotate_event *rot= proto_rotate_event(is, header);
-        m_binlog_file_name= rot->binlog_file;
-        m_binlog_offset= (unsigned long)rot->binlog_pos;
+        Rotate_event *rot= proto_rotate_event(dec, header, m_event_pool);
+        if (!dec.overrun())
+        {
+          m_binlog_file_name= rot->binlog_file;
+          m_binlog_offset= (unsigned long)rot->binlog_pos;
+        }
         parsed_event= rot;
       }
       break;
     case INTVAR_EVENT:
-      parsed_event= proto_intvar_event(is, header);
+      parsed_event= proto_intvar_event(dec, header, m_event_pool);
       break;
     case USER_VAR_EVENT:
-      parsed_event= proto_uservar_event(is, header);
+      parsed_event= proto_uservar_event(dec, header, m_event_pool);
+      break;
+    case XID_EVENT:
+      parsed_event= proto_xid_event(dec, header, m_event_pool);
       break;
     default:
       {
         // Create a dummy driver.
-        parsed_event= new Binary_log_event(header);
+        parsed_event= create_event<Binary_log_event>(m_event_pool, header);
       }
   }
 
+  if (dec.overrun())
+  {
+    /*
+      The event was shorter than its fields say. Report it instead of
+      passing on an event with missing parts.
+    */
+    release_event(parsed_event);
+    parsed_event= create_incident_event(175, "Truncated event",
+                                        m_binlog_offset);
+  }
+
   return parsed_event;
 }
 
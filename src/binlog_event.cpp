@@ -19,6 +19,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 */
 
 #include "binlog_event.h"
+#include "decode_plan.h"
+#include "event_pool.h"
 #include <iostream>
 #include <cstring>
 
@@ -57,6 +59,8 @@ const char *get_event_type_str(Log_event_type type)
   case EXECUTE_LOAD_QUERY_EVENT: return "Execute_load_query";
   case INCIDENT_EVENT: return "Incident";
   case USER_DEFINED: return "User defined";
+  case TRANSACTION_BEGIN_EVENT: return "Transaction_begin";
+  case TRANSACTION_COMMIT_EVENT: return "Transaction_commit";
   default: return "Unknown";
   }
 }
@@ -66,6 +70,14 @@ const char *get_event_type_str(Log_event_type type)
 
 Binary_log_event::~Binary_log_event()
 {
+  if (m_pool)
+    m_pool->release();
+}
+
+Table_map_event::~Table_map_event()
+{
+  if (decode_plan)
+    decode_plan->release();
 }
 
 
@@ -80,4 +92,16 @@ Binary_log_event * create_incident_event(unsigned int type, const char *message,
   return incident;
 }
 
+Binary_log_event *create_rotate_event(const std::string &file, unsigned long pos)
+{
+  Log_event_header header;
+  memset(&header, 0, sizeof(header));
+  header.type_code= ROTATE_EVENT;
+  header.event_length= LOG_EVENT_HEADER_SIZE + 8 + file.size();
+  Rotate_event *rotate= new Rotate_event(&header);
+  rotate->binlog_file= file;
+  rotate->binlog_pos= pos;
+  return rotate;
+}
+
 } // end namespace mysql
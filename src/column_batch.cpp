@@ -0,0 +1,261 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#include <string.h>
+
+#include "column_batch.h"
+
+using namespace mysql::system;
+
+namespace mysql {
+
+/*
+  How a non NULL field is turned into a column value.
+*/
+enum Cell_decoder
+{
+  DECODE_INT8, DECODE_INT16, DECODE_INT24, DECODE_INT32, DECODE_INT64,
+  DECODE_UINT24, DECODE_UINT32, DECODE_UNSIGNED,
+  DECODE_FLOAT, DECODE_DOUBLE,
+  DECODE_PREFIXED, DECODE_RAW
+};
+
+static Cell_decoder choose_decoder(const Column_plan &col)
+{
+  switch (col.type)
+  {
+  case MYSQL_TYPE_TINY:
+    return DECODE_INT8;
+  case MYSQL_TYPE_SHORT:
+    return DECODE_INT16;
+  case MYSQL_TYPE_INT24:
+    return DECODE_INT24;
+  case MYSQL_TYPE_LONG:
+    return DECODE_INT32;
+  case MYSQL_TYPE_LONGLONG:
+  case MYSQL_TYPE_DATETIME:
+    return DECODE_INT64;
+  case MYSQL_TYPE_NEWDATE:
+  case MYSQL_TYPE_DATE:
+  case MYSQL_TYPE_TIME:
+    return DECODE_UINT24;
+  case MYSQL_TYPE_TIMESTAMP:
+    return DECODE_UINT32;
+  case MYSQL_TYPE_YEAR:
+    return DECODE_UNSIGNED;
+  case MYSQL_TYPE_FLOAT:
+    return col.fixed_size == 4 ? DECODE_FLOAT : DECODE_RAW;
+  case MYSQL_TYPE_DOUBLE:
+    return col.fixed_size == 8 ? DECODE_DOUBLE : DECODE_RAW;
+  default:
+    break;
+  }
+  if (col.size_kind == LENGTH_PREFIXED)
+    return DECODE_PREFIXED;
+  /* ENUM and SET are sent as MYSQL_TYPE_STRING with the real type in the metadata */
+  unsigned char real_type= col.metadata >> 8U;
+  if (col.type == MYSQL_TYPE_STRING &&
+      (real_type == MYSQL_TYPE_ENUM || real_type == MYSQL_TYPE_SET) &&
+      col.fixed_size <= 8)
+    return DECODE_UNSIGNED;
+  return DECODE_RAW;
+}
+
+static Column_vector_type vector_type(Cell_decoder decoder)
+{
+  switch (decoder)
+  {
+  case DECODE_FLOAT:
+  case DECODE_DOUBLE:
+    return COLUMN_DOUBLE;
+  case DECODE_PREFIXED:
+  case DECODE_RAW:
+    return COLUMN_BINARY;
+  default:
+    return COLUMN_INT64;
+  }
+}
+
+void Column_vector::clear()
+{
+  m_size= 0;
+  m_null_count= 0;
+  m_int64.clear();
+  m_double.clear();
+  m_offsets.resize(1);
+  m_data.clear();
+  m_validity.clear();
+}
+
+Column_batch::Column_batch(const Table_map_event *table_map)
+  : m_plan(const_cast<Decode_plan *>(get_decode_plan(table_map))),
+    m_table_id(table_map->table_id), m_row_count(0)
+{
+  m_plan->add_ref();
+  size_t count= m_plan->column_count();
+  m_decoders.reserve(count);
+  m_columns.reserve(count);
+  for (size_t col_no= 0; col_no < count; ++col_no)
+  {
+    Cell_decoder decoder= choose_decoder(m_plan->column(col_no));
+    m_decoders.push_back(decoder);
+    m_columns.push_back(Column_vector(vector_type(decoder)));
+  }
+}
+
+Column_batch::~Column_batch()
+{
+  m_plan->release();
+}
+
+int Column_batch::append(const Row_event *row_event, Image image)
+{
+  if (row_event->table_id != m_table_id)
+    return 1;
+
+  Log_event_type type= row_event->get_event_type();
+  const unsigned char *row= row_event->row.data();
+  size_t size= row_event->row.size();
+  size_t null_bits_len= row_event->null_bits_len;
+
+  /*
+    Images of an update alternate between before and after. Inserts only
+    have after images and deletes only before images.
+  */
+  bool take_first= type == UPDATE_ROWS_EVENT ? image == BEFORE_IMAGE :
+                   type == WRITE_ROWS_EVENT ? image == CURRENT_IMAGE : true;
+  bool take_second= type == UPDATE_ROWS_EVENT ? image == CURRENT_IMAGE :
+                    take_first;
+  bool first= true;
+
+  size_t offset= 0;
+  while (offset < size)
+  {
+    size_t next;
+    if (first ? take_first : take_second)
+      next= append_row(row, offset, null_bits_len);
+    else
+      next= m_plan->skip_row(row, offset, null_bits_len);
+    if (next <= offset || next > size)
+      break;
+    offset= next;
+    if (type == UPDATE_ROWS_EVENT)
+      first= !first;
+  }
+  return 0;
+}
+
+size_t Column_batch::append_row(const unsigned char *row, size_t offset,
+                                size_t null_bits_len)
+{
+  const unsigned char *null_bits= row + offset;
+  size_t count= m_columns.size();
+  offset+= null_bits_len;
+
+  for (size_t col_no= 0; col_no < count; ++col_no)
+  {
+    Column_vector &vec= m_columns[col_no];
+    if (null_bits[col_no / 8] & (1 << (col_no & 7)))
+    {
+      vec.append_null();
+      continue;
+    }
+
+    const unsigned char *field= row + offset;
+    uint32_t size= m_plan->field_size(col_no, field);
+    offset+= size;
+
+    switch (m_decoders[col_no])
+    {
+    case DECODE_INT8:
+      vec.m_int64.push_back((int8_t) Int_reader<1>::load(field));
+      break;
+    case DECODE_INT16:
+      vec.m_int64.push_back((int16_t) Int_reader<2>::load(field));
+      break;
+    case DECODE_INT24:
+    {
+      int64_t value= Int_reader<3>::load(field);
+      if (value & 0x800000)
+        value-= 0x1000000;
+      vec.m_int64.push_back(value);
+      break;
+    }
+    case DECODE_INT32:
+      vec.m_int64.push_back((int32_t) Int_reader<4>::load(field));
+      break;
+    case DECODE_INT64:
+      vec.m_int64.push_back((int64_t) Int_reader<8>::load(field));
+      break;
+    case DECODE_UINT24:
+      vec.m_int64.push_back(Int_reader<3>::load(field));
+      break;
+    case DECODE_UINT32:
+      vec.m_int64.push_back(Int_reader<4>::load(field));
+      break;
+    case DECODE_UNSIGNED:
+    {
+      uint64_t value= 0;
+      for (uint32_t i= 0; i < size; ++i)
+        value|= (uint64_t) field[i] << (8 * i);
+      vec.m_int64.push_back((int64_t) value);
+      break;
+    }
+    case DECODE_FLOAT:
+    {
+      uint32_t bits= Int_reader<4>::load(field);
+      float value;
+      memcpy(&value, &bits, sizeof(value));
+      vec.m_double.push_back(value);
+      break;
+    }
+    case DECODE_DOUBLE:
+    {
+      uint64_t bits= Int_reader<8>::load(field);
+      double value;
+      memcpy(&value, &bits, sizeof(value));
+      vec.m_double.push_back(value);
+      break;
+    }
+    case DECODE_PREFIXED:
+    {
+      uint8_t prefix= m_plan->column(col_no).prefix_width;
+      vec.append_binary(field + prefix, size - prefix);
+      continue;
+    }
+    default:
+      vec.append_binary(field, size);
+      continue;
+    }
+    vec.append_validity(true);
+  }
+  ++m_row_count;
+  return offset;
+}
+
+void Column_batch::clear()
+{
+  for (std::vector<Column_vector>::iterator it= m_columns.begin();
+       it != m_columns.end(); ++it)
+    it->clear();
+  m_row_count= 0;
+}
+
+} // end namespace mysql
@@ -0,0 +1,190 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#include "decode_plan.h"
+#include "field_iterator.h"
+
+using namespace mysql::system;
+
+namespace mysql {
+
+static void set_fixed(Column_plan &col, uint32_t size)
+{
+  col.size_kind= FIXED_SIZE;
+  col.prefix_width= 0;
+  col.fixed_size= size;
+}
+
+static void set_length_prefixed(Column_plan &col, uint8_t prefix_width)
+{
+  col.size_kind= LENGTH_PREFIXED;
+  col.prefix_width= prefix_width;
+  col.fixed_size= 0;
+}
+
+/**
+  Classify a column the same way calc_field_size() sizes its fields.
+*/
+static void plan_column(Column_plan &col)
+{
+  uint32_t metadata= col.metadata;
+  switch (col.type) {
+  case MYSQL_TYPE_VAR_STRING:
+  case MYSQL_TYPE_DECIMAL:
+  case MYSQL_TYPE_FLOAT:
+  case MYSQL_TYPE_DOUBLE:
+    set_fixed(col, metadata);
+    break;
+  case MYSQL_TYPE_NEWDECIMAL:
+  case MYSQL_TYPE_NULL:
+    set_fixed(col, 0);
+    break;
+  case MYSQL_TYPE_SET:
+  case MYSQL_TYPE_ENUM:
+  case MYSQL_TYPE_STRING:
+  {
+    unsigned char type= metadata >> 8U;
+    if ((type == MYSQL_TYPE_SET) || (type == MYSQL_TYPE_ENUM))
+      set_fixed(col, metadata & 0x00ff);
+    else
+      set_length_prefixed(col, 1);
+    break;
+  }
+  case MYSQL_TYPE_YEAR:
+  case MYSQL_TYPE_TINY:
+    set_fixed(col, 1);
+    break;
+  case MYSQL_TYPE_SHORT:
+    set_fixed(col, 2);
+    break;
+  case MYSQL_TYPE_INT24:
+  case MYSQL_TYPE_NEWDATE:
+  case MYSQL_TYPE_DATE:
+  case MYSQL_TYPE_TIME:
+    set_fixed(col, 3);
+    break;
+  case MYSQL_TYPE_LONG:
+  case MYSQL_TYPE_TIMESTAMP:
+    set_fixed(col, 4);
+    break;
+  case MYSQL_TYPE_LONGLONG:
+  case MYSQL_TYPE_DATETIME:
+    set_fixed(col, 8);
+    break;
+  case MYSQL_TYPE_BIT:
+  {
+    uint32_t from_len= (metadata >> 8U) & 0x00ff;
+    uint32_t from_bit_len= metadata & 0x00ff;
+    set_fixed(col, from_len + ((from_bit_len > 0) ? 1 : 0));
+    break;
+  }
+  case MYSQL_TYPE_VARCHAR:
+    set_length_prefixed(col, metadata > 255 ? 2 : 1);
+    break;
+  case MYSQL_TYPE_TINY_BLOB:
+  case MYSQL_TYPE_MEDIUM_BLOB:
+  case MYSQL_TYPE_LONG_BLOB:
+  case MYSQL_TYPE_BLOB:
+  case MYSQL_TYPE_GEOMETRY:
+    if (metadata >= 1 && metadata <= 4)
+      set_length_prefixed(col, metadata);
+    else
+      set_fixed(col, 0);
+    break;
+  default:
+    set_fixed(col, ~(uint32_t) 0);
+  }
+}
+
+Decode_plan::Decode_plan(const Table_map_event *table_map)
+  : m_columns(table_map->columns.size()), m_types(table_map->columns),
+    m_metadata(table_map->metadata), m_all_fixed(true), m_row_fixed_size(0)
+{
+  size_t meta_offset= 0;
+  for (size_t col_no= 0; col_no < m_columns.size(); ++col_no)
+  {
+    Column_plan &col= m_columns[col_no];
+    col.type= m_types[col_no];
+    col.metadata= 0;
+
+    /* Same decoding as extract_metadata() without the rescan */
+    int meta_size= lookup_metadata_field_size((system::enum_field_types) col.type);
+    if (meta_offset + meta_size <= m_metadata.size())
+    {
+      if (meta_size == 1)
+        col.metadata= m_metadata[meta_offset];
+      else if (meta_size == 2)
+        col.metadata= m_metadata[meta_offset] |
+                      ((uint32_t) m_metadata[meta_offset + 1] << 8);
+    }
+    meta_offset+= meta_size;
+
+    plan_column(col);
+    if (col.size_kind == FIXED_SIZE)
+      m_row_fixed_size+= col.fixed_size;
+    else
+      m_all_fixed= false;
+  }
+}
+
+bool Decode_plan::matches(const Table_map_event *table_map) const
+{
+  return table_map->columns == m_types && table_map->metadata == m_metadata;
+}
+
+size_t Decode_plan::skip_row(const unsigned char *row, size_t offset,
+                             size_t null_bits_len) const
+{
+  const unsigned char *null_bits= row + offset;
+  offset+= null_bits_len;
+
+  size_t count= m_columns.size();
+  if (m_all_fixed && null_bits_len * 8 >= count)
+  {
+    /* The padding bits after the last column may be set; ignore them */
+    unsigned char any_null= 0;
+    for (size_t i= 0; i < count / 8; ++i)
+      any_null|= null_bits[i];
+    if (count & 7)
+      any_null|= null_bits[count / 8] & ((1 << (count & 7)) - 1);
+    if (!any_null)
+      return offset + m_row_fixed_size;
+  }
+
+  for (size_t col_no= 0; col_no < count; ++col_no)
+  {
+    if (null_bits[col_no / 8] & (1 << (col_no & 7)))
+      continue;
+    offset+= field_size(col_no, row + offset);
+  }
+  return offset;
+}
+
+const Decode_plan *get_decode_plan(const Table_map_event *table_map)
+{
+  if (table_map->decode_plan == 0)
+  {
+    Table_map_event *tm= const_cast<Table_map_event *>(table_map);
+    tm->decode_plan= new Decode_plan(table_map);
+  }
+  return table_map->decode_plan;
+}
+
+} // end namespace mysql
@@ -0,0 +1,148 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#include <cstring>
+
+#include "event_buffer.h"
+
+namespace mysql {
+
+Event_buffer::Event_buffer(size_t capacity)
+  : m_data(new char[capacity]), m_capacity(capacity), m_pool(0),
+    m_owns_data(true)
+{
+}
+
+Event_buffer::Event_buffer(char *data, size_t capacity)
+  : m_data(data), m_capacity(capacity), m_pool(0), m_owns_data(false)
+{
+}
+
+Event_buffer::~Event_buffer()
+{
+  if (m_owns_data)
+    delete [] m_data;
+}
+
+void Event_buffer::destroy()
+{
+  if (m_pool)
+    m_pool->put(this);
+  else
+    delete this;
+}
+
+Event_buffer_pool::Event_buffer_pool(size_t buffer_size, size_t max_free)
+  : m_buffer_size(buffer_size), m_max_free(max_free)
+{
+  pthread_mutex_init(&m_mutex, NULL);
+}
+
+Event_buffer_pool::~Event_buffer_pool()
+{
+  for (std::vector<Event_buffer *>::iterator it= m_free.begin();
+       it != m_free.end(); ++it)
+    delete *it;
+  pthread_mutex_destroy(&m_mutex);
+}
+
+Event_buffer *Event_buffer_pool::get()
+{
+  Event_buffer *buffer= 0;
+  pthread_mutex_lock(&m_mutex);
+  if (!m_free.empty())
+  {
+    buffer= m_free.back();
+    m_free.pop_back();
+  }
+  pthread_mutex_unlock(&m_mutex);
+
+  if (buffer == 0)
+  {
+    buffer= new Event_buffer(m_buffer_size);
+    buffer->m_pool= this;
+  }
+  /* Every buffer handed out keeps the pool alive */
+  add_ref();
+  return buffer;
+}
+
+void Event_buffer_pool::put(Event_buffer *buffer)
+{
+  bool keep;
+  buffer->reset_ref_count();
+  pthread_mutex_lock(&m_mutex);
+  keep= m_free.size() < m_max_free;
+  if (keep)
+    m_free.push_back(buffer);
+  pthread_mutex_unlock(&m_mutex);
+  if (!keep)
+    delete buffer;
+  release();
+}
+
+Event_payload::Event_payload(const Event_payload &other)
+  : m_data(other.m_data), m_size(other.m_size), m_buffer(other.m_buffer)
+{
+  if (m_buffer)
+    m_buffer->add_ref();
+}
+
+Event_payload &Event_payload::operator=(const Event_payload &other)
+{
+  if (other.m_buffer)
+    other.m_buffer->add_ref();
+  clear();
+  m_data= other.m_data;
+  m_size= other.m_size;
+  m_buffer= other.m_buffer;
+  return *this;
+}
+
+void Event_payload::assign(const char *data, size_t size, Event_buffer *buffer)
+{
+  buffer->add_ref();
+  clear();
+  m_data= (const uint8_t *)data;
+  m_size= size;
+  m_buffer= buffer;
+}
+
+void Event_payload::assign(const char *data, size_t size)
+{
+  clear();
+  if (size == 0)
+    return;
+  m_buffer= new Event_buffer(size);
+  memcpy(m_buffer->data(), data, size);
+  m_data= (const uint8_t *)m_buffer->data();
+  m_size= size;
+}
+
+void Event_payload::clear()
+{
+  if (m_buffer)
+    m_buffer->release();
+  m_buffer= 0;
+  m_data= 0;
+  m_size= 0;
+}
+
+} // end namespace mysql
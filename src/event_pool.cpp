@@ -0,0 +1,134 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#include "event_pool.h"
+#include "decode_plan.h"
+
+namespace mysql {
+
+Event_pool::Event_pool(size_t max_free)
+  : m_max_free(max_free)
+{
+  pthread_mutex_init(&m_mutex, NULL);
+}
+
+Event_pool::~Event_pool()
+{
+  for (size_t type_code= 0; type_code < 256; ++type_code)
+  {
+    std::vector<Binary_log_event *> &free_list= m_free[type_code];
+    for (std::vector<Binary_log_event *>::iterator it= free_list.begin();
+         it != free_list.end(); ++it)
+    {
+      /* The unused events hold no reference to the pool */
+      (*it)->m_pool= 0;
+      delete *it;
+    }
+  }
+  pthread_mutex_destroy(&m_mutex);
+}
+
+namespace {
+
+/**
+  Drop the references of an event to other objects now rather than when
+  the event is reused, so that receive buffers and decode plans can be
+  recycled.
+*/
+void drop_references(Binary_log_event *event)
+{
+  switch (event->get_event_type())
+  {
+  case WRITE_ROWS_EVENT:
+  case UPDATE_ROWS_EVENT:
+  case DELETE_ROWS_EVENT:
+    static_cast<Row_event *>(event)->row.clear();
+    static_cast<Row_event *>(event)->transaction_seq_no= 0;
+    break;
+  case TABLE_MAP_EVENT:
+  {
+    Table_map_event *table_map= static_cast<Table_map_event *>(event);
+    if (table_map->decode_plan)
+      table_map->decode_plan->release();
+    table_map->decode_plan= 0;
+    table_map->transaction_seq_no= 0;
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+} // end anonymous namespace
+
+void Event_pool::put(Binary_log_event **events, size_t count)
+{
+  for (size_t i= 0; i < count; ++i)
+    drop_references(events[i]);
+
+  /* The events which are kept are cleared from the array */
+  pthread_mutex_lock(&m_mutex);
+  for (size_t i= 0; i < count; ++i)
+  {
+    std::vector<Binary_log_event *> &free_list=
+      m_free[events[i]->header()->type_code];
+    if (free_list.size() < m_max_free)
+    {
+      free_list.push_back(events[i]);
+      events[i]= 0;
+    }
+  }
+  pthread_mutex_unlock(&m_mutex);
+
+  /*
+    The references of the deleted events to the pool are released
+    together with those of the kept ones.
+  */
+  for (size_t i= 0; i < count; ++i)
+  {
+    if (events[i])
+    {
+      events[i]->m_pool= 0;
+      delete events[i];
+    }
+  }
+  release((int) count);
+}
+
+void release_events(Binary_log_event **events, size_t count)
+{
+  size_t start= 0;
+  while (start < count)
+  {
+    Event_pool *pool= events[start]->pool();
+    if (pool == 0)
+    {
+      delete events[start++];
+      continue;
+    }
+    size_t end= start + 1;
+    while (end < count && events[end]->pool() == pool)
+      ++end;
+    pool->put(events + start, end - start);
+    start= end;
+  }
+}
+
+} // end namespace mysql
@@ -18,6 +18,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 02110-1301  USA
 */
 
+#include <algorithm>
+
 #include "file_driver.h"
 
 namespace mysql { namespace system {
@@ -115,54 +117,75 @@ using namespace std;
 
     try
     {
-      if(m_bytes_read < m_binlog_file_size && m_binlog_file.good())
+      while (m_bytes_read < m_binlog_file_size && m_binlog_file.good())
       {
-        //Protocol_chunk<uint8_t> prot_marker(m_event_log_header.marker);
-        Protocol_chunk<uint32_t> prot_timestamp(m_event_log_header.timestamp);
-        Protocol_chunk<uint8_t> prot_type_code(m_event_log_header.type_code);
-        Protocol_chunk<uint32_t> prot_server_id(m_event_log_header.server_id);
-        Protocol_chunk<uint32_t>
-          prot_event_length(m_event_log_header.event_length);
-        Protocol_chunk<uint32_t>
-          prot_next_position(m_event_log_header.next_position);
-        Protocol_chunk<uint16_t> prot_flags(m_event_log_header.flags);
-
-        m_binlog_file >> prot_timestamp
-                      >> prot_type_code
-                      >> prot_server_id
-                      >> prot_event_length
-                      >> prot_next_position
-                      >> prot_flags;
+        char header[LOG_EVENT_HEADER_SIZE - 1];
+        m_binlog_file.read(header, LOG_EVENT_HEADER_SIZE - 1);
+        Buffer_decoder header_dec(header, LOG_EVENT_HEADER_SIZE - 1);
+        proto_event_header(header_dec, &m_event_log_header);
+        if (m_event_log_header.event_length < LOG_EVENT_HEADER_SIZE - 1)
+          return ERR_FAIL;
+
+        size_t body_length= m_event_log_header.event_length -
+                            (LOG_EVENT_HEADER_SIZE - 1);
+        if (!is_subscribed(m_event_log_header.type_code))
+        {
+          m_binlog_file.seekg(body_length, ios::cur);
+          m_bytes_read= m_binlog_file.tellg();
+          continue;
+        }
 
         /*
-        m_binlog_file.read(reinterpret_cast<char*>(&m_event_log_header.timestamp),
-                           sizeof(uint32_t));
-        m_binlog_file.read(reinterpret_cast<char*>(&m_event_log_header.type_code),
-                           sizeof(uint8_t));
-        m_binlog_file.read(reinterpret_cast<char*>(&m_event_log_header.server_id),
-                           sizeof(uint32_t));
-        m_binlog_file.read(reinterpret_cast<char*>(&m_event_log_header.event_length),
-                           sizeof(uint32_t));
-        m_binlog_file.read(reinterpret_cast<char*>(&m_event_log_header.next_position),
-                           sizeof(uint32_t));
-        m_binlog_file.read(reinterpret_cast<char*>(&m_event_log_header.flags),
-                           sizeof(uint16_t));
-                           */
-
-        *event= parse_event(* static_cast<std::istream*> (&m_binlog_file),
-                            &m_event_log_header);
+          Read the table id and the flags of a rows event first so that
+          the rows of an excluded table can be stepped over.
+        */
+        char head[8];
+        size_t head_length= 0;
+        if (!table_filter().empty() && body_length >= sizeof(head) &&
+            m_event_log_header.type_code >= WRITE_ROWS_EVENT &&
+            m_event_log_header.type_code <= DELETE_ROWS_EVENT)
+        {
+          m_binlog_file.read(head, sizeof(head));
+          head_length= sizeof(head);
+          if (is_excluded_rows_event(m_event_log_header.type_code, head,
+                                     head_length))
+          {
+            m_binlog_file.seekg(body_length - head_length, ios::cur);
+            m_bytes_read= m_binlog_file.tellg();
+            continue;
+          }
+        }
 
         /*
-          Correction. Except for the default case (above), this condition should
-          always fail.
+          Read the rest of the body with one call and decode it from
+          memory. Bodies are packed one after the other into a shared
+          block, so events which are kept pin the block together instead
+          of a block each. A new block is started when the body doesn't
+          fit into the free tail; a block no event refers to any more is
+          reused from its start.
         */
-        if (m_bytes_read + m_event_log_header.event_length !=
-            m_binlog_file.tellg())
-          m_binlog_file.seekg(m_bytes_read + m_event_log_header.event_length,
-                              ios::beg);
+        if (m_event_buffer && m_event_buffer->is_unique())
+          m_event_buffer_used= 0;
+        if (m_event_buffer == 0 ||
+            m_event_buffer->capacity() - m_event_buffer_used < body_length)
+        {
+          if (m_event_buffer)
+            m_event_buffer->release();
+          m_event_buffer= new Event_buffer(std::max(body_length,
+                                                    (size_t) FILE_BUFFER_SIZE));
+          m_event_buffer_used= 0;
+        }
+        char *body= m_event_buffer->data() + m_event_buffer_used;
+        memcpy(body, head, head_length);
+        m_binlog_file.read(body + head_length, body_length - head_length);
+        m_event_buffer_used+= body_length;
+
+        Buffer_decoder dec(body, body_length, m_event_buffer);
+        *event= parse_event(dec, &m_event_log_header);
 
         m_bytes_read= m_binlog_file.tellg();
 
+        /* Otherwise the event was dropped by a filter */
         if(*event)
           return ERR_OK;
       }
@@ -0,0 +1,66 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#include <iostream>
+
+#include "logging.h"
+
+namespace mysql { namespace system {
+
+int log_level= MRL_LOG_WARNING;
+
+static const char *level_names[]=
+{
+  "NONE", "ERROR", "WARNING", "INFO", "DEBUG"
+};
+
+static void default_log_handler(int level, const std::string &message)
+{
+  if (level < MRL_LOG_ERROR || level > MRL_LOG_DEBUG)
+    level= MRL_LOG_DEBUG;
+  std::cerr << "[mysql-replication-listener] " << level_names[level]
+            << ": " << message << std::endl;
+}
+
+static Log_handler log_handler= default_log_handler;
+
+void set_log_level(int level)
+{
+  __atomic_store_n(&log_level, level, __ATOMIC_RELAXED);
+}
+
+int get_log_level()
+{
+  return __atomic_load_n(&log_level, __ATOMIC_RELAXED);
+}
+
+void set_log_handler(Log_handler handler)
+{
+  __atomic_store_n(&log_handler, handler ? handler : default_log_handler,
+                   __ATOMIC_RELEASE);
+}
+
+void log_message(int level, const std::string &message)
+{
+  Log_handler handler= __atomic_load_n(&log_handler, __ATOMIC_ACQUIRE);
+  handler(level, message);
+}
+
+} } // end namespace mysql::system
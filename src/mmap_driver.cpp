@@ -0,0 +1,216 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#include <fcntl.h>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "binlog_api.h"
+#include "mmap_driver.h"
+#include "file_driver.h"
+
+namespace mysql { namespace system {
+
+Mapped_file *Mapped_file::open(const std::string &path)
+{
+  int fd= ::open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+    return 0;
+
+  struct stat stat_buff;
+  void *data= MAP_FAILED;
+  if (fstat(fd, &stat_buff) == 0)
+  {
+    /* A file which was just created has nothing to map yet */
+    if (stat_buff.st_size == 0)
+      data= 0;
+    else
+      data= mmap(0, stat_buff.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  /* The mapping keeps the file open */
+  close(fd);
+  if (data == MAP_FAILED)
+    return 0;
+  return new Mapped_file((char *) data, stat_buff.st_size);
+}
+
+Mapped_file::~Mapped_file()
+{
+  if (size() > 0)
+    munmap(data(), size());
+}
+
+void Mapped_file::advise(size_t offset, size_t length, int advice)
+{
+  if (offset >= size())
+    return;
+  /* madvise() wants a page aligned start */
+  size_t page_size= sysconf(_SC_PAGESIZE);
+  size_t start= offset - offset % page_size;
+  if (length > size() - offset)
+    length= size() - offset;
+  madvise(data() + start, length + (offset - start), advice);
+}
+
+Binlog_mmap_driver::~Binlog_mmap_driver()
+{
+  disconnect();
+}
+
+int Binlog_mmap_driver::connect()
+{
+  disconnect();
+  Mapped_file *file= Mapped_file::open(m_path);
+  if (file == 0)
+    return ERR_FAIL;
+  return attach(file, MAGIC_NUMBER_SIZE);
+}
+
+int Binlog_mmap_driver::attach(Mapped_file *file, unsigned long position)
+{
+  static const char magic[]= {(char) 0xfe, 0x62, 0x69, 0x6e};
+
+  Binlog_mmap_driver::disconnect();
+  /*
+    A file which is still being written may not even have its magic
+    number yet; reading it then finds the rest missing.
+  */
+  size_t magic_length= std::min(file->size(), (size_t) MAGIC_NUMBER_SIZE);
+  if ((magic_length > 0 && memcmp(file->data(), magic, magic_length)) ||
+      position < MAGIC_NUMBER_SIZE ||
+      (position > file->size() && position != MAGIC_NUMBER_SIZE))
+  {
+    file->release();
+    return ERR_FAIL;                            // Not a valid binlog file.
+  }
+  file->advise(0, file->size(), MADV_SEQUENTIAL);
+  m_file= file;
+  m_position= position;
+  return ERR_OK;
+}
+
+int Binlog_mmap_driver::disconnect()
+{
+  if (m_file)
+  {
+    m_file->release();
+    m_file= 0;
+  }
+  return ERR_OK;
+}
+
+/**
+  True if name, a path or the name of a file, refers to the file at path.
+*/
+static bool is_same_file(const std::string &name, const std::string &path)
+{
+  if (name.find('/') != std::string::npos)
+    return name == path;
+  size_t slash= path.rfind('/');
+  size_t start= slash == std::string::npos ? 0 : slash + 1;
+  return path.compare(start, std::string::npos, name) == 0;
+}
+
+int Binlog_mmap_driver::set_position(const std::string &str,
+                                     unsigned long position)
+{
+  /* Only the mapped file can be read */
+  if (!str.empty() && !is_same_file(str, m_path))
+    return ERR_FAIL;
+  if (m_file == 0 || position > m_file->size())
+    return ERR_FAIL;
+  m_position= position;
+  return ERR_OK;
+}
+
+int Binlog_mmap_driver::get_position(std::string *str, unsigned long *position)
+{
+  if (str)
+    *str= m_path;
+  if (position)
+    *position= m_position;
+  return ERR_OK;
+}
+
+int Binlog_mmap_driver::wait_for_next_event(mysql::Binary_log_event **event)
+{
+  bool short_tail;
+  int rc= read_event(event, &short_tail);
+  /* Nothing is appended to the mapping, so the file is truncated */
+  return short_tail ? ERR_FAIL : rc;
+}
+
+int Binlog_mmap_driver::read_event(mysql::Binary_log_event **event,
+                                   bool *short_tail)
+{
+  *short_tail= false;
+  if (m_file == 0)
+    return ERR_FAIL;
+
+  const size_t header_length= LOG_EVENT_HEADER_SIZE - 1;
+  size_t file_size= m_file->size();
+  if (m_position > file_size)
+  {
+    *short_tail= true;                          // Truncated magic number.
+    return ERR_EOF;
+  }
+  while (m_position < file_size)
+  {
+    const char *header= m_file->data() + m_position;
+    if (file_size - m_position < header_length)
+    {
+      *short_tail= true;                        // Truncated header.
+      return ERR_EOF;
+    }
+    Buffer_decoder header_dec(header, header_length);
+    proto_event_header(header_dec, &m_event_log_header);
+    size_t event_length= m_event_log_header.event_length;
+    if (event_length < header_length)
+      return ERR_FAIL;
+    if (event_length > file_size - m_position)
+    {
+      *short_tail= true;                        // Truncated body.
+      return ERR_EOF;
+    }
+    m_position+= event_length;
+
+    const char *body= header + header_length;
+    size_t body_length= event_length - header_length;
+    if (!is_subscribed(m_event_log_header.type_code) ||
+        (!table_filter().empty() &&
+         is_excluded_rows_event(m_event_log_header.type_code, body,
+                                body_length)))
+      continue;
+
+    /* The event refers into the mapping instead of a copy of the body */
+    Buffer_decoder dec(body, body_length, m_file);
+    *event= parse_event(dec, &m_event_log_header);
+
+    /* Otherwise the event was dropped by a filter */
+    if (*event)
+      return ERR_OK;
+  }
+  return ERR_EOF;
+}
+
+}
+}
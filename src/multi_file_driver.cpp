@@ -0,0 +1,377 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#include <ctype.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+
+#include "binlog_api.h"
+#include "multi_file_driver.h"
+#include "file_driver.h"
+
+namespace mysql { namespace system {
+
+namespace {
+
+std::string base_name(const std::string &path)
+{
+  size_t slash= path.rfind('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+std::string dir_name(const std::string &path)
+{
+  size_t slash= path.rfind('/');
+  if (slash == std::string::npos)
+    return ".";
+  return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+/**
+ * A binlog file in a directory, named <base>.<sequence number>.
+ */
+struct Binlog_name
+{
+  std::string base;
+  unsigned long number;
+  std::string name;
+
+  bool operator<(const Binlog_name &other) const
+  {
+    if (base != other.base)
+      return base < other.base;
+    return number < other.number;
+  }
+};
+
+/**
+ * Split the name of a binlog file into its base name and sequence number.
+ *
+ * @return False if name isn't the name of a binlog file
+ */
+bool parse_binlog_name(const std::string &name, Binlog_name &binlog)
+{
+  size_t dot= name.rfind('.');
+  if (dot == std::string::npos || dot == 0 || dot + 1 == name.size())
+    return false;
+  for (size_t i= dot + 1; i < name.size(); ++i)
+    if (!isdigit((unsigned char) name[i]))
+      return false;
+  binlog.base= name.substr(0, dot);
+  binlog.number= strtoul(name.c_str() + dot + 1, NULL, 10);
+  binlog.name= name;
+  return true;
+}
+
+} // end anonymous namespace
+
+int list_binlog_files(const std::string &source, const std::string &start_file,
+                      std::vector<std::string> &out)
+{
+  struct stat stat_buff;
+  if (stat(source.c_str(), &stat_buff) == -1)
+    return ERR_FAIL;
+
+  std::vector<std::string> files;
+  if (S_ISDIR(stat_buff.st_mode))
+  {
+    DIR *dir= opendir(source.c_str());
+    if (dir == 0)
+      return ERR_FAIL;
+    std::vector<Binlog_name> binlogs;
+    Binlog_name binlog;
+    while (struct dirent *entry= readdir(dir))
+      if (parse_binlog_name(entry->d_name, binlog))
+        binlogs.push_back(binlog);
+    closedir(dir);
+    std::sort(binlogs.begin(), binlogs.end());
+
+    /* Only the files of one server, named like the start file */
+    std::string base;
+    if (!start_file.empty() && parse_binlog_name(base_name(start_file),
+                                                 binlog))
+      base= binlog.base;
+    else if (!binlogs.empty())
+      base= binlogs.front().base;
+    for (size_t i= 0; i < binlogs.size(); ++i)
+      if (binlogs[i].base == base)
+        files.push_back(source + "/" + binlogs[i].name);
+  }
+  else
+  {
+    /* The server writes the paths relative to the directory of the index */
+    std::ifstream index(source.c_str());
+    if (!index)
+      return ERR_FAIL;
+    std::string dir= dir_name(source);
+    std::string line;
+    while (std::getline(index, line))
+    {
+      size_t end= line.find_last_not_of(" \t\r");
+      if (end == std::string::npos)
+        continue;
+      line.erase(end + 1);
+      if (line.compare(0, 2, "./") == 0)
+        line.erase(0, 2);
+      files.push_back(line[0] == '/' ? line : dir + "/" + line);
+    }
+  }
+  out.swap(files);
+  return ERR_OK;
+}
+
+Binlog_multi_file_driver::Binlog_multi_file_driver(const std::string &source,
+                                                   const std::string &start_file,
+                                                   unsigned long offset)
+  : Binlog_mmap_driver(std::string(), 0), m_source(source),
+    m_start_file(start_file), m_start_offset(offset), m_current(0),
+    m_connected(false), m_rotate_position(0), m_next(0), m_prefetched(false)
+{
+}
+
+Binlog_multi_file_driver::~Binlog_multi_file_driver()
+{
+  disconnect();
+}
+
+int Binlog_multi_file_driver::load_files()
+{
+  return list_binlog_files(m_source, m_start_file, m_files);
+}
+
+long Binlog_multi_file_driver::find_file(const std::string &file) const
+{
+  std::string name= base_name(file);
+  for (size_t i= 0; i < m_files.size(); ++i)
+    if (base_name(m_files[i]) == name)
+      return i;
+  return -1;
+}
+
+int Binlog_multi_file_driver::connect()
+{
+  disconnect();
+  if (load_files() || m_files.empty())
+    return ERR_FAIL;
+  long index= m_start_file.empty() ? 0 : find_file(m_start_file);
+  if (index < 0)
+    return ERR_FAIL;
+  if (open_file(index, std::max(m_start_offset,
+                                (unsigned long) MAGIC_NUMBER_SIZE)))
+    return ERR_FAIL;
+  m_connected= true;
+  return ERR_OK;
+}
+
+int Binlog_multi_file_driver::disconnect()
+{
+  if (m_next)
+  {
+    m_next->release();
+    m_next= 0;
+  }
+  m_connected= false;
+  return Binlog_mmap_driver::disconnect();
+}
+
+int Binlog_multi_file_driver::open_file(size_t index, unsigned long position)
+{
+  Mapped_file *file;
+  if (m_next && m_next_index == index)
+  {
+    file= m_next;
+    m_next= 0;
+  }
+  else
+    file= Mapped_file::open(m_files[index]);
+  if (m_next)
+  {
+    m_next->release();
+    m_next= 0;
+  }
+  if (file == 0)
+    return ERR_FAIL;
+
+  m_path= m_files[index];
+  m_current= index;
+  m_rotate_file.clear();
+  m_prefetched= false;
+  return attach(file, position);
+}
+
+int Binlog_multi_file_driver::remap_grown_file()
+{
+  struct stat stat_buff;
+  if (stat(m_path.c_str(), &stat_buff) == -1 ||
+      (size_t) stat_buff.st_size <= m_file->size())
+    return 0;
+  Mapped_file *file= Mapped_file::open(m_path);
+  if (file == 0 || attach(file, m_position))
+    return -1;
+  return 1;
+}
+
+void Binlog_multi_file_driver::prefetch()
+{
+  m_prefetched= true;
+  size_t index= m_current + 1;
+  if (index >= m_files.size())
+    return;
+  m_next= Mapped_file::open(m_files[index]);
+  if (m_next)
+  {
+    m_next_index= index;
+    m_next->advise(0, MULTI_FILE_PREFETCH_SIZE, MADV_WILLNEED);
+  }
+}
+
+int Binlog_multi_file_driver::wait_for_next_event(mysql::Binary_log_event **event)
+{
+  if (!m_connected)
+    return ERR_FAIL;
+
+  for (;;)
+  {
+    bool short_tail;
+    int rc= read_event(event, &short_tail);
+    if (rc == ERR_OK)
+    {
+      if ((*event)->get_event_type() == ROTATE_EVENT)
+      {
+        Rotate_event *rotate= static_cast<Rotate_event *>(*event);
+        m_rotate_file= rotate->binlog_file;
+        m_rotate_position= rotate->binlog_pos;
+      }
+      if (!m_prefetched && m_file->size() - m_position < MULTI_FILE_PREFETCH_SIZE)
+        prefetch();
+      return ERR_OK;
+    }
+    if (rc != ERR_EOF)
+      return rc;
+
+    /*
+      The last file may end in an event which is still being written, so
+      wait for the rest of it. The file is looked at after the list, so
+      a file which is followed by others and didn't grow is truncated.
+    */
+    if (short_tail)
+    {
+      bool last= m_current + 1 >= m_files.size();
+      if (last)
+      {
+        std::string current= m_path;
+        if (load_files())
+          return ERR_EOF;
+        long index= find_file(current);
+        m_current= index < 0 ? m_files.size() : index;
+      }
+      int grown= remap_grown_file();
+      if (grown < 0)
+        return ERR_FAIL;
+      if (grown)
+        continue;
+      return last ? ERR_EOF : ERR_FAIL;
+    }
+
+    /*
+      Go on with the file the rotate event names if it comes later in the
+      list, else with the next one of the list. At the end of the list,
+      look for files added since it was read.
+    */
+    long next= m_rotate_file.empty() ? -1 : find_file(m_rotate_file);
+    unsigned long position= MAGIC_NUMBER_SIZE;
+    bool follows_rotate= next >= 0 && (size_t) next > m_current;
+    if (follows_rotate)
+      position= std::max(m_rotate_position, (unsigned long) MAGIC_NUMBER_SIZE);
+    else if (m_current + 1 < m_files.size())
+      next= m_current + 1;
+    else
+    {
+      if (m_next)
+      {
+        m_next->release();
+        m_next= 0;
+      }
+      std::string current= m_path;
+      if (load_files())
+        return ERR_EOF;
+      long index= find_file(current);
+
+      /*
+        Read what was written to the file since it was mapped, such as its
+        rotate event, before moving on. The file is looked at after the
+        list, so a file which was done once the next one showed up is read
+        to its end.
+      */
+      int grown= remap_grown_file();
+      if (grown < 0)
+        return ERR_FAIL;
+      if (grown)
+      {
+        m_current= index < 0 ? m_files.size() : index;
+        continue;
+      }
+      m_current= index < 0 ? m_files.size() : index;
+      if (m_current + 1 >= m_files.size())
+        return ERR_EOF;
+
+      /* Look for the file of the rotate event again in the new list */
+      continue;
+    }
+    if (open_file(next, position))
+      return ERR_FAIL;
+
+    /*
+      Tell where the stream goes on, as a server does, unless the last
+      rotate event already did.
+    */
+    if (!follows_rotate && is_subscribed(ROTATE_EVENT))
+    {
+      *event= create_rotate_event(base_name(m_path), position);
+      return ERR_OK;
+    }
+  }
+}
+
+int Binlog_multi_file_driver::set_position(const std::string &str,
+                                           unsigned long position)
+{
+  if (!m_connected)
+  {
+    if (!str.empty())
+      m_start_file= str;
+    m_start_offset= position;
+    return ERR_OK;
+  }
+
+  if (str.empty() || base_name(str) == base_name(m_path))
+    return Binlog_mmap_driver::set_position(std::string(), position);
+  long index= find_file(str);
+  if (index < 0)
+    return ERR_FAIL;
+  return open_file(index, position);
+}
+
+}
+}
@@ -0,0 +1,258 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#include "parallel_decoder.h"
+#include "basic_transaction_parser.h"
+#include "event_pool.h"
+
+namespace mysql {
+
+/**
+ * Decode every row image of a rows event.
+ */
+static void decode_images(const Decode_plan *plan, Row_event *row_event,
+                          Decoded_rows &decoded)
+{
+  decoded.row_event= row_event;
+  const unsigned char *row= row_event->row.data();
+  size_t size= row_event->row.size();
+  size_t offset= 0;
+  while (offset < size)
+  {
+    decoded.images.push_back(Row_of_fields());
+    size_t next= plan->decode_row(row, offset, row_event->null_bits_len,
+                                  decoded.images.back());
+    if (next <= offset || next > size)
+    {
+      /* A corrupt image; drop it rather than reading past the event */
+      decoded.images.pop_back();
+      break;
+    }
+    offset= next;
+  }
+}
+
+static bool is_rows_event(const Binary_log_event *event)
+{
+  int type= event->get_event_type();
+  return type == WRITE_ROWS_EVENT || type == UPDATE_ROWS_EVENT ||
+         type == DELETE_ROWS_EVENT;
+}
+
+Decoded_event::~Decoded_event()
+{
+  if (m_plan)
+    m_plan->release();
+  release_event(event);
+}
+
+Parallel_decoder::Parallel_decoder(size_t workers, size_t window)
+  : m_window(window > 0 ? window : 1, (Decoded_event *) 0),
+    m_submitted(0), m_delivered(0), m_shutdown(false)
+{
+  pthread_mutex_init(&m_mutex, NULL);
+  pthread_cond_init(&m_work_available, NULL);
+  pthread_cond_init(&m_result_ready, NULL);
+  pthread_cond_init(&m_slot_free, NULL);
+
+  for (size_t i= 0; i < (workers > 0 ? workers : 1); ++i)
+  {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, &Parallel_decoder::run_worker, this))
+      break;
+    m_workers.push_back(thread);
+  }
+}
+
+Parallel_decoder::~Parallel_decoder()
+{
+  pthread_mutex_lock(&m_mutex);
+  m_shutdown= true;
+  pthread_cond_broadcast(&m_work_available);
+  pthread_mutex_unlock(&m_mutex);
+
+  for (size_t i= 0; i < m_workers.size(); ++i)
+    pthread_join(m_workers[i], NULL);
+
+  for (; m_delivered < m_submitted; ++m_delivered)
+    delete m_window[m_delivered % m_window.size()];
+
+  pthread_mutex_destroy(&m_mutex);
+  pthread_cond_destroy(&m_work_available);
+  pthread_cond_destroy(&m_result_ready);
+  pthread_cond_destroy(&m_slot_free);
+}
+
+int Parallel_decoder::submit(Binary_log_event *event,
+                             const Table_map_event *table_map)
+{
+  int error= 0;
+  Decoded_event *result= new Decoded_event(event, 0);
+  bool needs_worker= true;
+
+  if (is_rows_event(event))
+  {
+    Row_event *row_event= static_cast<Row_event *>(event);
+    if (table_map && table_map->table_id == row_event->table_id)
+    {
+      /*
+        The plan is taken here because the caller may replace the table
+        map before a worker gets to the event.
+      */
+      result->m_plan= const_cast<Decode_plan *>(get_decode_plan(table_map));
+      result->m_plan->add_ref();
+    }
+    else
+    {
+      error= 1;
+      needs_worker= false;
+    }
+  }
+  else
+  {
+    Transaction_log_event *trans= dynamic_cast<Transaction_log_event *>(event);
+    needs_worker= trans != 0 && !trans->is_spilled();
+  }
+
+  /* Without workers the caller's thread does the work */
+  if (needs_worker && m_workers.empty())
+  {
+    decode(result);
+    needs_worker= false;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+  while (m_submitted - m_delivered >= m_window.size())
+    pthread_cond_wait(&m_slot_free, &m_mutex);
+  result->sequence= m_submitted++;
+  m_window[result->sequence % m_window.size()]= result;
+  if (needs_worker)
+  {
+    m_work.push_back(result);
+    pthread_cond_signal(&m_work_available);
+  }
+  else
+  {
+    result->m_ready= true;
+    pthread_cond_signal(&m_result_ready);
+  }
+  pthread_mutex_unlock(&m_mutex);
+  return error;
+}
+
+Decoded_event *Parallel_decoder::next()
+{
+  pthread_mutex_lock(&m_mutex);
+  Decoded_event *result;
+  while ((result= try_next_locked()) == 0)
+    pthread_cond_wait(&m_result_ready, &m_mutex);
+  pthread_mutex_unlock(&m_mutex);
+  return result;
+}
+
+Decoded_event *Parallel_decoder::try_next()
+{
+  pthread_mutex_lock(&m_mutex);
+  Decoded_event *result= try_next_locked();
+  pthread_mutex_unlock(&m_mutex);
+  return result;
+}
+
+Decoded_event *Parallel_decoder::try_next_locked()
+{
+  if (m_delivered == m_submitted)
+    return 0;
+  Decoded_event *result= m_window[m_delivered % m_window.size()];
+  if (!result->m_ready)
+    return 0;
+  m_window[m_delivered % m_window.size()]= 0;
+  ++m_delivered;
+  pthread_cond_signal(&m_slot_free);
+  return result;
+}
+
+size_t Parallel_decoder::pending() const
+{
+  pthread_mutex_lock(&m_mutex);
+  size_t count= m_submitted - m_delivered;
+  pthread_mutex_unlock(&m_mutex);
+  return count;
+}
+
+void *Parallel_decoder::run_worker(void *arg)
+{
+  Parallel_decoder *decoder= static_cast<Parallel_decoder *>(arg);
+  pthread_mutex_lock(&decoder->m_mutex);
+  while (true)
+  {
+    while (decoder->m_work.empty() && !decoder->m_shutdown)
+      pthread_cond_wait(&decoder->m_work_available, &decoder->m_mutex);
+    if (decoder->m_shutdown)
+      break;
+    Decoded_event *result= decoder->m_work.front();
+    decoder->m_work.pop_front();
+    pthread_mutex_unlock(&decoder->m_mutex);
+
+    decoder->decode(result);
+
+    pthread_mutex_lock(&decoder->m_mutex);
+    result->m_ready= true;
+    /* Only the oldest result unblocks the consumer */
+    if (result->sequence == decoder->m_delivered)
+      pthread_cond_signal(&decoder->m_result_ready);
+  }
+  pthread_mutex_unlock(&decoder->m_mutex);
+  return NULL;
+}
+
+void Parallel_decoder::decode(Decoded_event *result)
+{
+  if (result->m_plan)
+  {
+    result->rows.resize(1);
+    decode_images(result->m_plan, static_cast<Row_event *>(result->event),
+                  result->rows[0]);
+    result->m_plan->release();
+    result->m_plan= 0;
+    return;
+  }
+
+  /*
+    An in memory transaction. Its table maps belong to it alone, so
+    building their plans here doesn't race with other workers.
+  */
+  Transaction_log_event *trans=
+    static_cast<Transaction_log_event *>(result->event);
+  for (Event_list::iterator it= trans->m_events.begin();
+       it != trans->m_events.end(); ++it)
+  {
+    if (!is_rows_event(*it))
+      continue;
+    Row_event *row_event= static_cast<Row_event *>(*it);
+    Int_to_Event_map::iterator tm= trans->table_map().find(row_event->table_id);
+    if (tm == trans->table_map().end())
+      continue;
+    result->rows.push_back(Decoded_rows());
+    decode_images(get_decode_plan(static_cast<Table_map_event *>(tm->second)),
+                  row_event, result->rows.back());
+  }
+}
+
+} // end namespace mysql
@@ -0,0 +1,319 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#include <algorithm>
+
+#include "binlog_api.h"
+#include "parallel_file_driver.h"
+#include "mmap_driver.h"
+#include "file_driver.h"
+#include "event_pool.h"
+
+namespace mysql { namespace system {
+
+static std::string base_name(const std::string &path)
+{
+  size_t slash= path.rfind('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+Binlog_parallel_file_driver::
+Binlog_parallel_file_driver(const std::vector<std::string> &files,
+                            size_t threads, size_t read_ahead)
+  : Binary_log_driver(std::string(), 0), m_files(files),
+    m_thread_count(threads > 0 ? threads : 1),
+    m_read_ahead(read_ahead > 0 ? read_ahead : 1), m_start_index(0),
+    m_start_offset(MAGIC_NUMBER_SIZE), m_connected(false), m_stopping(0),
+    m_current(0), m_position(0), m_next_file(0), m_error(ERR_OK),
+    m_interrupted(false)
+{
+  pthread_mutex_init(&m_mutex, NULL);
+  pthread_cond_init(&m_changed, NULL);
+}
+
+Binlog_parallel_file_driver::~Binlog_parallel_file_driver()
+{
+  disconnect();
+  pthread_mutex_destroy(&m_mutex);
+  pthread_cond_destroy(&m_changed);
+}
+
+int Binlog_parallel_file_driver::connect()
+{
+  disconnect();
+  if (m_start_index >= m_files.size())
+    return ERR_FAIL;
+
+  m_stopping= 0;
+  m_error= ERR_OK;
+  m_current= m_start_index;
+  m_next_file= m_start_index;
+  m_position= std::max(m_start_offset, (unsigned long) MAGIC_NUMBER_SIZE);
+  m_rotate_file.clear();
+  m_finished.assign(m_files.size(), 0);
+  /* A queue for every file which may be parsed before the consumer moves */
+  m_queues.assign(m_files.size(), (Item_queue *) 0);
+  for (size_t i= m_current;
+       i < m_files.size() && i < m_current + m_thread_count; ++i)
+  {
+    m_queues[i]= new Item_queue(m_read_ahead);
+    if (m_interrupted)
+      m_queues[i]->close();
+  }
+  m_connected= true;
+
+  for (size_t i= 0; i < m_thread_count; ++i)
+  {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, &Binlog_parallel_file_driver::run_worker,
+                       this))
+      break;
+    m_threads.push_back(thread);
+  }
+  if (m_threads.empty())
+  {
+    disconnect();
+    return ERR_FAIL;
+  }
+  return ERR_OK;
+}
+
+int Binlog_parallel_file_driver::disconnect()
+{
+  if (!m_connected)
+    return ERR_OK;
+
+  pthread_mutex_lock(&m_mutex);
+  __atomic_store_n(&m_stopping, 1, __ATOMIC_RELEASE);
+  for (size_t i= 0; i < m_queues.size(); ++i)
+    if (m_queues[i])
+      m_queues[i]->close();
+  pthread_cond_broadcast(&m_changed);
+  pthread_mutex_unlock(&m_mutex);
+
+  for (size_t i= 0; i < m_threads.size(); ++i)
+    pthread_join(m_threads[i], NULL);
+  m_threads.clear();
+
+  /* All threads are gone, so the events read ahead can be released */
+  Pipeline_item item;
+  for (size_t i= 0; i < m_queues.size(); ++i)
+  {
+    if (m_queues[i] == 0)
+      continue;
+    while (m_queues[i]->try_pop(&item))
+      if (item.event)
+        release_event(item.event);
+    delete m_queues[i];
+  }
+  m_queues.clear();
+  m_connected= false;
+  return ERR_OK;
+}
+
+void *Binlog_parallel_file_driver::run_worker(void *arg)
+{
+  Binlog_parallel_file_driver *driver=
+    static_cast<Binlog_parallel_file_driver *>(arg);
+
+  pthread_mutex_lock(&driver->m_mutex);
+  for (;;)
+  {
+    /* Only take up files which have a queue */
+    while (!driver->m_stopping &&
+           (driver->m_next_file >= driver->m_files.size() ||
+            driver->m_next_file >= driver->m_current + driver->m_thread_count))
+      pthread_cond_wait(&driver->m_changed, &driver->m_mutex);
+    if (driver->m_stopping)
+      break;
+
+    size_t index= driver->m_next_file++;
+    pthread_mutex_unlock(&driver->m_mutex);
+    driver->scan(index);
+    pthread_mutex_lock(&driver->m_mutex);
+    driver->m_finished[index]= 1;
+    pthread_cond_broadcast(&driver->m_changed);
+  }
+  pthread_mutex_unlock(&driver->m_mutex);
+  return 0;
+}
+
+void Binlog_parallel_file_driver::scan(size_t index)
+{
+  Binlog_mmap_driver driver(m_files[index]);
+  driver.set_event_mask(event_mask());
+  driver.set_table_filter(table_filter());
+
+  Pipeline_item item;
+  item.event= 0;
+  item.error= driver.connect();
+  if (item.error == ERR_OK && index == m_start_index &&
+      m_start_offset > MAGIC_NUMBER_SIZE)
+    item.error= driver.set_position("", m_start_offset);
+
+  while (item.error == ERR_OK)
+  {
+    item.error= driver.wait_for_next_event(&item.event);
+    if (item.error != ERR_OK)
+      break;
+    if (!push(index, item))
+    {
+      release_event(item.event);
+      return;
+    }
+  }
+
+  /* The end of the file, or the error which ended it */
+  item.event= 0;
+  push(index, item);
+}
+
+bool Binlog_parallel_file_driver::push(size_t index, const Pipeline_item &item)
+{
+  Item_queue *queue= m_queues[index];
+  while (!queue->wait_push(item))
+  {
+    pthread_mutex_lock(&m_mutex);
+    while (queue->is_closed() && !m_stopping)
+      pthread_cond_wait(&m_changed, &m_mutex);
+    pthread_mutex_unlock(&m_mutex);
+    if (stopping())
+      return false;
+  }
+  return true;
+}
+
+int Binlog_parallel_file_driver::wait_for_next_event(mysql::Binary_log_event **event)
+{
+  if (!m_connected)
+    return ERR_FAIL;
+  if (m_error != ERR_OK)
+    return m_error;
+
+  while (m_current < m_files.size())
+  {
+    Pipeline_item item;
+    if (!m_queues[m_current]->wait_pop(&item))
+      return ERR_EOF;                           // Interrupted.
+    if (item.event)
+    {
+      m_position= item.event->header()->next_position;
+      m_rotate_file.clear();
+      if (item.event->get_event_type() == ROTATE_EVENT)
+        m_rotate_file= static_cast<Rotate_event *>(item.event)->binlog_file;
+      *event= item.event;
+      return ERR_OK;
+    }
+    if (item.error != ERR_EOF)
+    {
+      m_error= item.error;
+      return m_error;
+    }
+
+    /*
+      Go on with the next file and let a thread take up the file which
+      now fits in the window.
+    */
+    pthread_mutex_lock(&m_mutex);
+    while (!m_finished[m_current])
+      pthread_cond_wait(&m_changed, &m_mutex);
+    delete m_queues[m_current];
+    m_queues[m_current]= 0;
+    ++m_current;
+    size_t last= m_current + m_thread_count - 1;
+    if (last < m_files.size())
+    {
+      m_queues[last]= new Item_queue(m_read_ahead);
+      if (m_interrupted)
+        m_queues[last]->close();
+    }
+    pthread_cond_broadcast(&m_changed);
+    pthread_mutex_unlock(&m_mutex);
+    if (m_current < m_files.size())
+    {
+      m_position= MAGIC_NUMBER_SIZE;
+      /*
+        Tell where the stream goes on, as a server does, unless the last
+        rotate event already did.
+      */
+      std::string name= base_name(m_files[m_current]);
+      if (m_rotate_file != name && is_subscribed(ROTATE_EVENT))
+      {
+        m_rotate_file= name;
+        *event= create_rotate_event(name, m_position);
+        return ERR_OK;
+      }
+    }
+  }
+  return ERR_EOF;
+}
+
+int Binlog_parallel_file_driver::set_position(const std::string &str,
+                                              unsigned long position)
+{
+  size_t index= m_connected ? m_current : m_start_index;
+  if (!str.empty())
+  {
+    std::string name= base_name(str);
+    for (index= 0; index < m_files.size(); ++index)
+      if (base_name(m_files[index]) == name)
+        break;
+  }
+  if (index >= m_files.size())
+    return ERR_FAIL;
+
+  m_start_index= index;
+  m_start_offset= position;
+  return m_connected ? connect() : ERR_OK;
+}
+
+int Binlog_parallel_file_driver::get_position(std::string *str,
+                                              unsigned long *position)
+{
+  if (str && !m_files.empty())
+    *str= m_files[std::min(m_current, m_files.size() - 1)];
+  if (position)
+    *position= m_position;
+  return ERR_OK;
+}
+
+void Binlog_parallel_file_driver::interrupt()
+{
+  pthread_mutex_lock(&m_mutex);
+  m_interrupted= true;
+  for (size_t i= 0; i < m_queues.size(); ++i)
+    if (m_queues[i])
+      m_queues[i]->close();
+  pthread_mutex_unlock(&m_mutex);
+}
+
+void Binlog_parallel_file_driver::resume()
+{
+  pthread_mutex_lock(&m_mutex);
+  m_interrupted= false;
+  for (size_t i= 0; i < m_queues.size(); ++i)
+    if (m_queues[i])
+      m_queues[i]->reopen();
+  pthread_cond_broadcast(&m_changed);
+  pthread_mutex_unlock(&m_mutex);
+}
+
+}
+}
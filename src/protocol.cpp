@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 #include <iostream>
 
 #include "protocol.h"
+#include "logging.h"
 
 using namespace mysql;
 using namespace mysql::system;
@@ -37,6 +38,7 @@ int proto_read_package_header(tcp::socket *socket, unsigned long *packet_length,
                         asio::transfer_at_least(4));
   } catch (asio::system_error e)
   {
+    MRL_ERROR("Failed to read package header: " << e.what());
     return 1;
   }
   *packet_length=  (unsigned long)(buf[0] &0xFF);
@@ -59,6 +61,7 @@ int proto_read_package_header(tcp::socket *socket, asio::streambuf &buff, unsign
                         asio::transfer_at_least(4-inbuff));
     } catch (asio::system_error e)
     {
+      MRL_ERROR("Failed to read package header: " << e.what());
       return 1;
     }
   }
@@ -319,25 +322,30 @@ std::ostream &operator<<(std::ostream &os, Protocol &chunk)
   return os;
 }
 
-Query_event *proto_query_event(std::istream &is, Log_event_header *header)
+void proto_event_header(Buffer_decoder &dec, Log_event_header *h)
+{
+  dec.read(h->timestamp)
+     .read(h->type_code)
+     .read(h->server_id)
+     .read(h->event_length)
+     .read(h->next_position)
+     .read(h->flags);
+}
+
+Query_event *proto_query_event(Buffer_decoder &dec, Log_event_header *header,
+                               Event_pool *pool)
 {
   uint8_t db_name_len;
   uint16_t var_size;
   // Length of query stored in the payload.
   uint32_t query_len;
-  Query_event *qev=new Query_event(header);
-
-  Protocol_chunk<uint32_t> proto_query_event_thread_id(qev->thread_id);
-  Protocol_chunk<uint32_t> proto_query_event_exec_time(qev->exec_time);
-  Protocol_chunk<uint8_t> proto_query_event_db_name_len(db_name_len);
-  Protocol_chunk<uint16_t> proto_query_event_error_code(qev->error_code);
-  Protocol_chunk<uint16_t> proto_query_event_var_size(var_size);
+  Query_event *qev= create_event<Query_event>(pool, header);
 
-  is >> proto_query_event_thread_id
-     >> proto_query_event_exec_time
-     >> proto_query_event_db_name_len
-     >> proto_query_event_error_code
-     >> proto_query_event_var_size;
+  dec.read(qev->thread_id)
+     .read(qev->exec_time)
+     .read(db_name_len)
+     .read(qev->error_code)
+     .read(var_size);
 
   //TODO : Implement it in a better way.
 
@@ -362,195 +370,241 @@ Query_event *proto_query_event(std::istream &is, Log_event_header *header)
   query_len= header->event_length - (LOG_EVENT_HEADER_SIZE + 13 + var_size +
                                      db_name_len);
 
-  qev->variables.reserve(var_size);
-  Protocol_chunk_vector proto_payload(qev->variables, var_size);
-  is >> proto_payload;
-
-  Protocol_chunk_string proto_query_event_db_name(qev->db_name,
-                                                  (unsigned long)db_name_len);
-
-  Protocol_chunk_string proto_query_event_query_str
-    (qev->query, (unsigned long)query_len);
-
-  char zero_marker; // should always be 0;
-  is >> proto_query_event_db_name
-     >> zero_marker
-     >> proto_query_event_query_str;
-  // Following is not really required now,
-  //qev->query.resize(qev->query.size() - 1); // Last character is a '\0' character.
+  dec.read_bytes(qev->variables, var_size)
+     .read_string(qev->db_name, db_name_len)
+     .skip(1)                                   // should always be 0
+     .read_string(qev->query, query_len);
 
   return qev;
 }
 
-Rotate_event *proto_rotate_event(std::istream &is, Log_event_header *header)
+Rotate_event *proto_rotate_event(Buffer_decoder &dec, Log_event_header *header,
+                                 Event_pool *pool)
 {
-  Rotate_event *rev= new Rotate_event(header);
+  Rotate_event *rev= create_event<Rotate_event>(pool, header);
 
   uint32_t file_name_length= header->event_length - 7 - LOG_EVENT_HEADER_SIZE;
 
-  Protocol_chunk<uint64_t > prot_position(rev->binlog_pos);
-  Protocol_chunk_string prot_file_name(rev->binlog_file, file_name_length);
-  is >> prot_position
-     >> prot_file_name;
+  dec.read(rev->binlog_pos)
+     .read_string(rev->binlog_file, file_name_length);
 
   return rev;
 }
 
-Incident_event *proto_incident_event(std::istream &is, Log_event_header *header)
+Incident_event *proto_incident_event(Buffer_decoder &dec,
+                                     Log_event_header *header,
+                                     Event_pool *pool)
 {
-  Incident_event *incident= new Incident_event(header);
-  Protocol_chunk<uint8_t> proto_incident_code(incident->type);
-  Protocol_chunk_string_len      proto_incident_message(incident->message);
+  Incident_event *incident= create_event<Incident_event>(pool, header);
 
-  is >> proto_incident_code
-     >> proto_incident_message;
+  dec.read(incident->type)
+     .read_string_len(incident->message);
 
   return incident;
 }
 
-Row_event *proto_rows_event(std::istream &is, Log_event_header *header)
+Row_event *proto_rows_event(Buffer_decoder &dec, Log_event_header *header,
+                            Event_pool *pool)
 {
-  Row_event *rev=new Row_event(header);
+  Row_event *rev= create_event<Row_event>(pool, header);
+  const char *start= dec.current();
 
-  union
-  {
-    uint64_t integer;
-    uint8_t bytes[6];
-  } table_id;
+  dec.read_int<6>(rev->table_id)
+     .read(rev->flags)
+     .read_length_encoded(rev->columns_len);
 
-  table_id.integer=0L;
-  Protocol_chunk<uint8_t>  proto_table_id(&table_id.bytes[0], 6);
-  Protocol_chunk<uint16_t> proto_flags(rev->flags);
-  Protocol_chunk<uint64_t> proto_column_len(rev->columns_len);
-  proto_column_len.set_length_encoded_binary(true);
-
-  is >> proto_table_id
-     >> proto_flags
-     >> proto_column_len;
-
-  rev->table_id = table_id.integer;
   int used_column_len=(int) ((rev->columns_len + 7) / 8);
-  Protocol_chunk_vector proto_used_columns(rev->used_columns, used_column_len);
   rev->null_bits_len= used_column_len;
 
-  is >> proto_used_columns;
+  dec.read_bytes(rev->used_columns, used_column_len);
 
   if (header->type_code == UPDATE_ROWS_EVENT)
-  {
-    Protocol_chunk_vector proto_columns_before_image(rev->columns_before_image, used_column_len);
-    is >> proto_columns_before_image;
-  }
+    dec.read_bytes(rev->columns_before_image, used_column_len);
 
-  int bytes_read=proto_table_id.size() + proto_flags.size() + proto_column_len.size() + used_column_len;
-  if (header->type_code == UPDATE_ROWS_EVENT)
-    bytes_read+=used_column_len;
+  int bytes_read= dec.current() - start;
 
   unsigned long row_len= header->event_length - bytes_read - LOG_EVENT_HEADER_SIZE + 1;
-  std::cout << "Bytes read: " << bytes_read << " Bytes expected: " << row_len << std::endl;
-  Protocol_chunk_vector proto_row(rev->row, row_len);
-  is >> proto_row;
+  MRL_DEBUG("Rows event header: " << bytes_read << " bytes, row images: "
+            << row_len << " bytes");
+  dec.read_payload(rev->row, row_len);
 
   return rev;
 }
 
-Int_var_event *proto_intvar_event(std::istream &is, Log_event_header *header)
+Int_var_event *proto_intvar_event(Buffer_decoder &dec, Log_event_header *header,
+                                  Event_pool *pool)
 {
-  Int_var_event *event= new Int_var_event(header);
+  Int_var_event *event= create_event<Int_var_event>(pool, header);
 
-  Protocol_chunk<uint8_t>  proto_type(event->type);
-  Protocol_chunk<uint64_t> proto_value(event->value);
-  is >> proto_type
-     >> proto_value;
+  dec.read(event->type)
+     .read(event->value);
 
   return event;
 }
 
-User_var_event *proto_uservar_event(std::istream &is, Log_event_header *header)
+User_var_event *proto_uservar_event(Buffer_decoder &dec,
+                                    Log_event_header *header,
+                                    Event_pool *pool)
 {
-  User_var_event *event= new User_var_event(header);
+  User_var_event *event= create_event<User_var_event>(pool, header);
 
   uint32_t name_len;
-  Protocol_chunk<uint32_t> proto_name_len(name_len);
-
-  is >> proto_name_len;
-
-  Protocol_chunk_string proto_name(event->name, name_len);
-  Protocol_chunk<uint8_t>  proto_null(event->is_null);
+  dec.read(name_len)
+     .read_string(event->name, name_len)
+     .read(event->is_null);
 
-  is >> proto_name >> proto_null;
   if (event->is_null)
   {
     event->type = User_var_event::STRING_TYPE;
     event->charset = 63;                        // Binary charset
+    event->value.clear();
   }
   else
   {
     uint32_t value_len;
-    Protocol_chunk<uint8_t> proto_type(event->type);
-    Protocol_chunk<uint32_t> proto_charset(event->charset);
-    Protocol_chunk<uint32_t> proto_val_len(value_len);
-    is >> proto_type >> proto_charset >> proto_val_len;
-    Protocol_chunk_string proto_value(event->value, value_len);
-    is >> proto_value;
+    dec.read(event->type)
+       .read(event->charset)
+       .read(value_len)
+       .read_string(event->value, value_len);
   }
 
   return event;
 }
 
-Table_map_event *proto_table_map_event(std::istream &is, Log_event_header *header)
+Xid *proto_xid_event(Buffer_decoder &dec, Log_event_header *header,
+                     Event_pool *pool)
 {
-  Table_map_event *tmev=new Table_map_event(header);
+  Xid *event= create_event<Xid>(pool, header);
+
+  dec.read(event->xid_id);
+
+  return event;
+}
+
+Table_map_event *proto_table_map_event(Buffer_decoder &dec,
+                                       Log_event_header *header,
+                                       Event_pool *pool)
+{
+  Table_map_event *tmev= create_event<Table_map_event>(pool, header);
   uint64_t columns_len= 0;
   uint64_t metadata_len= 0;
-  union
-  {
-    uint64_t integer;
-    uint8_t bytes[6];
-  } table_id;
-  char zero_marker= 0;
-
-  table_id.integer=0L;
-  Protocol_chunk<uint8_t> proto_table_id(&table_id.bytes[0], 6);
-  Protocol_chunk<uint16_t> proto_flags(tmev->flags);
-  Protocol_chunk_string_len proto_db_name(tmev->db_name);
-  Protocol_chunk<uint8_t> proto_marker(zero_marker); // Should be '\0'
-  Protocol_chunk_string_len proto_table_name(tmev->table_name);
-  Protocol_chunk<uint64_t> proto_columns_len(columns_len);
-  proto_columns_len.set_length_encoded_binary(true);
-
-  is >> proto_table_id
-     >> proto_flags
-     >> proto_db_name
-     >> proto_marker
-     >> proto_table_name
-     >> proto_marker
-     >> proto_columns_len;
-  tmev->table_id=table_id.integer;
-  Protocol_chunk_vector proto_columns(tmev->columns, columns_len);
-  Protocol_chunk<uint64_t> proto_metadata_len(metadata_len);
-  proto_metadata_len.set_length_encoded_binary(true);
-
-  is >> proto_columns
-     >> proto_metadata_len;
-  Protocol_chunk_vector proto_metadata(tmev->metadata, (unsigned long)metadata_len);
-  is >> proto_metadata;
-  unsigned long null_bits_len=(int) ((tmev->columns.size() + 7) / 8);
 
-  Protocol_chunk_vector proto_null_bits(tmev->null_bits, null_bits_len);
+  dec.read_int<6>(tmev->table_id)
+     .read(tmev->flags)
+     .read_string_len(tmev->db_name)
+     .skip(1)                                   // Should be '\0'
+     .read_string_len(tmev->table_name)
+     .skip(1)                                   // Should be '\0'
+     .read_length_encoded(columns_len)
+     .read_bytes(tmev->columns, columns_len)
+     .read_length_encoded(metadata_len)
+     .read_bytes(tmev->metadata, metadata_len);
+
+  unsigned long null_bits_len=(int) ((tmev->columns.size() + 7) / 8);
+  dec.read_bytes(tmev->null_bits, null_bits_len);
 
-  is >> proto_null_bits;
   return tmev;
 }
 
-std::istream &operator>>(std::istream &is, Protocol_chunk_vector &chunk)
+static void encode_int(std::vector<char> &out, uint64_t value, int bytes)
 {
-  unsigned long size= chunk.m_size;
-  for(int i=0; i< size; i++)
+  for (int i= 0; i < bytes; ++i)
+    out.push_back((char) (value >> (8 * i)));
+}
+
+static void encode_length(std::vector<char> &out, uint64_t value)
+{
+  if (value < 251)
+    encode_int(out, value, 1);
+  else if (value <= 0xffff)
   {
-    char ch;
-    is.get(ch);
-    chunk.m_vec->push_back(ch);
+    out.push_back((char) 252);
+    encode_int(out, value, 2);
+  }
+  else if (value <= 0xffffff)
+  {
+    out.push_back((char) 253);
+    encode_int(out, value, 3);
+  }
+  else
+  {
+    out.push_back((char) 254);
+    encode_int(out, value, 8);
+  }
+}
+
+template <class Container>
+static void encode_bytes(std::vector<char> &out, const Container &data)
+{
+  out.insert(out.end(), data.begin(), data.end());
+}
+
+bool proto_encode_event(std::vector<char> &out, Binary_log_event *event)
+{
+  Log_event_header *header= event->header();
+  size_t start= out.size();
+
+  encode_int(out, header->timestamp, 4);
+  encode_int(out, header->type_code, 1);
+  encode_int(out, header->server_id, 4);
+  encode_int(out, 0, 4);                        // Event length, set below
+  encode_int(out, header->next_position, 4);
+  encode_int(out, header->flags, 2);
+
+  switch (header->type_code)
+  {
+  case TABLE_MAP_EVENT:
+  {
+    Table_map_event *tm= static_cast<Table_map_event *>(event);
+    encode_int(out, tm->table_id, 6);
+    encode_int(out, tm->flags, 2);
+    encode_int(out, tm->db_name.size(), 1);
+    encode_bytes(out, tm->db_name);
+    out.push_back(0);
+    encode_int(out, tm->table_name.size(), 1);
+    encode_bytes(out, tm->table_name);
+    out.push_back(0);
+    encode_length(out, tm->columns.size());
+    encode_bytes(out, tm->columns);
+    encode_length(out, tm->metadata.size());
+    encode_bytes(out, tm->metadata);
+    encode_bytes(out, tm->null_bits);
+    break;
+  }
+  case WRITE_ROWS_EVENT:
+  case UPDATE_ROWS_EVENT:
+  case DELETE_ROWS_EVENT:
+  {
+    Row_event *rev= static_cast<Row_event *>(event);
+    encode_int(out, rev->table_id, 6);
+    encode_int(out, rev->flags, 2);
+    encode_length(out, rev->columns_len);
+    encode_bytes(out, rev->used_columns);
+    if (header->type_code == UPDATE_ROWS_EVENT)
+      encode_bytes(out, rev->columns_before_image);
+    encode_bytes(out, rev->row);
+    break;
   }
+  default:
+    out.resize(start);
+    return false;
+  }
+
+  uint32_t length= (uint32_t) (out.size() - start);
+  for (int i= 0; i < 4; ++i)
+    out[start + 9 + i]= (char) (length >> (8 * i));
+  return true;
+}
+
+std::istream &operator>>(std::istream &is, Protocol_chunk_vector &chunk)
+{
+  unsigned long size= chunk.m_size;
+  std::vector<uint8_t>::size_type offset= chunk.m_vec->size();
+  if (size == 0)
+    return is;
+  chunk.m_vec->resize(offset + size);
+  is.read((char *)&(*chunk.m_vec)[offset], size);
+  chunk.m_vec->resize(offset + is.gcount());
   return is;
 }
 
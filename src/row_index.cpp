@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#include "row_index.h"
+
+namespace mysql {
+
+Row_index::Row_index(const Row_event *row_event,
+                     const Table_map_event *table_map)
+  : m_plan(get_decode_plan(table_map)), m_row(row_event->row.data()),
+    m_null_bits_len(row_event->null_bits_len),
+    m_is_update(row_event->get_event_type() == UPDATE_ROWS_EVENT),
+    m_is_write(row_event->get_event_type() == WRITE_ROWS_EVENT),
+    m_rows(0)
+{
+  build(row_event);
+}
+
+Row_index::Row_index(const Row_event *row_event, const Decode_plan *plan)
+  : m_plan(plan), m_row(row_event->row.data()),
+    m_null_bits_len(row_event->null_bits_len),
+    m_is_update(row_event->get_event_type() == UPDATE_ROWS_EVENT),
+    m_is_write(row_event->get_event_type() == WRITE_ROWS_EVENT),
+    m_rows(0)
+{
+  build(row_event);
+}
+
+void Row_index::build(const Row_event *row_event)
+{
+  size_t size= row_event->row.size();
+  size_t offset= 0;
+
+  /*
+    Every image is at least as long as its null bits, which gives a good
+    guess for the number of images.
+  */
+  if (m_null_bits_len + m_plan->row_fixed_size() > 0)
+    m_offsets.reserve(size / (m_null_bits_len + m_plan->row_fixed_size()) + 1);
+
+  while (offset < size)
+  {
+    m_offsets.push_back((uint32_t) offset);
+    size_t next= m_plan->skip_row(m_row, offset, m_null_bits_len);
+    if (next <= offset || next > size)
+    {
+      /* A corrupt image; drop it rather than reading past the event */
+      m_offsets.pop_back();
+      break;
+    }
+    offset= next;
+  }
+  m_offsets.push_back((uint32_t) offset);
+
+  m_rows= image_count();
+  if (m_is_update)
+    m_rows/= 2;
+}
+
+} // end namespace mysql
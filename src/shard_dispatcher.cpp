@@ -0,0 +1,505 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#include <algorithm>
+
+#include "binlog_api.h"
+#include "shard_dispatcher.h"
+#include "event_pool.h"
+
+namespace mysql {
+
+static const uint64_t NO_SEQUENCE= ~(uint64_t) 0;
+
+/**
+ * FNV-1a, continuing from hash.
+ */
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t length)
+{
+  const unsigned char *p= (const unsigned char *) data;
+  for (size_t i= 0; i < length; ++i)
+  {
+    hash^= p[i];
+    hash*= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static const uint64_t FNV_OFFSET_BASIS= 14695981039346656037ULL;
+
+static bool is_rows_event(const Binary_log_event *event)
+{
+  int type= event->get_event_type();
+  return type == WRITE_ROWS_EVENT || type == UPDATE_ROWS_EVENT ||
+         type == DELETE_ROWS_EVENT;
+}
+
+uint64_t Table_shard_key::hash(const Table_map_event *table_map,
+                               const Row_image &) const
+{
+  uint64_t hash= fnv1a(FNV_OFFSET_BASIS, table_map->db_name.data(),
+                       table_map->db_name.size());
+  hash= fnv1a(hash, ".", 1);
+  return fnv1a(hash, table_map->table_name.data(),
+               table_map->table_name.size());
+}
+
+Column_shard_key::Column_shard_key() : m_default_columns(1, 0)
+{
+}
+
+void Column_shard_key::set_columns(const std::string &db,
+                                   const std::string &table,
+                                   const std::vector<size_t> &columns)
+{
+  m_columns[db][table]= columns;
+}
+
+const std::vector<size_t> &
+Column_shard_key::columns(const Table_map_event *table_map) const
+{
+  std::map<std::string, Table_columns>::const_iterator db=
+    m_columns.find(table_map->db_name);
+  if (db == m_columns.end())
+    return m_default_columns;
+  Table_columns::const_iterator table= db->second.find(table_map->table_name);
+  return table == db->second.end() ? m_default_columns : table->second;
+}
+
+uint64_t Column_shard_key::hash(const Table_map_event *table_map,
+                                const Row_image &image) const
+{
+  const std::vector<size_t> &key= columns(table_map);
+  const Decode_plan *plan= get_decode_plan(table_map);
+  size_t end= 0;
+  for (size_t i= 0; i < key.size(); ++i)
+    end= std::max(end, key[i] + 1);
+  end= std::min(end, plan->column_count());
+
+  /*
+    The fields before the last key column are stepped over by their size;
+    the null flag and the bytes of every key column go into the hash.
+  */
+  uint64_t hash= FNV_OFFSET_BASIS;
+  const unsigned char *field= image.data();
+  for (size_t col_no= 0; col_no < end; ++col_no)
+  {
+    bool is_null= image.is_null(col_no);
+    uint32_t size= is_null ? 0 : plan->field_size(col_no, field);
+    if (std::find(key.begin(), key.end(), col_no) != key.end())
+    {
+      unsigned char null_flag= is_null;
+      hash= fnv1a(hash, &null_flag, 1);
+      hash= fnv1a(hash, field, size);
+    }
+    field+= size;
+  }
+  return hash;
+}
+
+/**
+ * The events of a transaction, kept until all of its rows are applied.
+ * Every queued row holds a reference, and so does the dispatcher until
+ * the transaction is committed.
+ */
+class Shard_dispatcher::Batch : public Ref_counted
+{
+public:
+  explicit Batch(Shard_dispatcher *dispatcher)
+    : m_dispatcher(dispatcher), m_sequence(NO_SEQUENCE)
+  {
+  }
+
+  /** The batch takes over the event */
+  void add_event(Binary_log_event *event) { m_events.push_back(event); }
+
+  /** The entry of the batch in the watermark */
+  void set_sequence(uint64_t sequence) { m_sequence= sequence; }
+
+protected:
+  void destroy()
+  {
+    if (m_sequence != NO_SEQUENCE)
+      m_dispatcher->batch_applied(m_sequence);
+    for (size_t i= 0; i < m_events.size(); ++i)
+      release_event(m_events[i]);
+    delete this;
+  }
+
+private:
+  Shard_dispatcher *m_dispatcher;
+  std::vector<Binary_log_event *> m_events;
+  uint64_t m_sequence;
+};
+
+Shard_dispatcher::Shard_dispatcher(size_t shards, Shard_applier *applier,
+                                   size_t queue_size)
+  : m_applier(applier), m_key(&m_table_key),
+    m_shards(shards > 0 ? shards : 1), m_batch(0), m_in_transaction(false),
+    m_first_sequence(0), m_applied_position(0), m_barrier_count(0),
+    m_failed(0), m_error(0)
+{
+  pthread_mutex_init(&m_mutex, NULL);
+  pthread_cond_init(&m_changed, NULL);
+  subscribe_overloads(handled_events);
+
+  for (size_t i= 0; i < m_shards.size(); ++i)
+  {
+    Shard &shard= m_shards[i];
+    shard.dispatcher= this;
+    shard.number= i;
+    shard.queue= new spsc_queue<Shard_work>(queue_size);
+    /* Without a thread the rows of the shard are applied by the caller */
+    shard.running= pthread_create(&shard.thread, NULL,
+                                  &Shard_dispatcher::run_shard, &shard) == 0;
+  }
+}
+
+Shard_dispatcher::~Shard_dispatcher()
+{
+  Shard_work work;
+  work.kind= WORK_STOP;
+  work.batch= 0;
+  for (size_t i= 0; i < m_shards.size(); ++i)
+    if (m_shards[i].running)
+      m_shards[i].queue->wait_push(work);
+  for (size_t i= 0; i < m_shards.size(); ++i)
+  {
+    if (m_shards[i].running)
+      pthread_join(m_shards[i].thread, NULL);
+    delete m_shards[i].queue;
+  }
+
+  /* An uncommitted transaction doesn't move the watermark */
+  if (m_batch)
+    m_batch->release();
+
+  pthread_mutex_destroy(&m_mutex);
+  pthread_cond_destroy(&m_changed);
+}
+
+void *Shard_dispatcher::run_shard(void *arg)
+{
+  Shard *shard= static_cast<Shard *>(arg);
+  Shard_work work;
+  while (shard->queue->wait_pop(&work) && work.kind != WORK_STOP)
+    shard->dispatcher->apply(shard, work);
+  return 0;
+}
+
+void Shard_dispatcher::apply(Shard *shard, const Shard_work &work)
+{
+  if (work.kind == WORK_BARRIER)
+  {
+    pthread_mutex_lock(&m_mutex);
+    ++m_barrier_count;
+    pthread_cond_broadcast(&m_changed);
+    pthread_mutex_unlock(&m_mutex);
+    return;
+  }
+
+  if (!failed())
+  {
+    int error= m_applier->apply(shard->number, work.change);
+    if (error)
+      fail(error);
+  }
+  work.batch->release();
+}
+
+void Shard_dispatcher::fail(int error)
+{
+  pthread_mutex_lock(&m_mutex);
+  if (!m_failed)
+  {
+    __atomic_store_n(&m_error, error, __ATOMIC_RELEASE);
+    __atomic_store_n(&m_failed, 1, __ATOMIC_RELEASE);
+  }
+  pthread_cond_broadcast(&m_changed);
+  pthread_mutex_unlock(&m_mutex);
+}
+
+Shard_dispatcher::Batch *Shard_dispatcher::current_batch()
+{
+  if (m_batch == 0)
+    m_batch= new Batch(this);
+  return m_batch;
+}
+
+void Shard_dispatcher::push(size_t shard, const Shard_work &work)
+{
+  if (work.batch)
+    work.batch->add_ref();
+  if (m_shards[shard].running)
+    m_shards[shard].queue->wait_push(work);
+  else
+    apply(&m_shards[shard], work);
+}
+
+void Shard_dispatcher::push_row(size_t shard, const Row_change &change)
+{
+  Shard_work work;
+  work.kind= WORK_ROW;
+  work.batch= m_batch;
+  work.change= change;
+  push(shard, work);
+}
+
+void Shard_dispatcher::barrier()
+{
+  pthread_mutex_lock(&m_mutex);
+  m_barrier_count= 0;
+  pthread_mutex_unlock(&m_mutex);
+
+  Shard_work work;
+  work.kind= WORK_BARRIER;
+  work.batch= 0;
+  for (size_t i= 0; i < m_shards.size(); ++i)
+    push(i, work);
+
+  pthread_mutex_lock(&m_mutex);
+  while (m_barrier_count < m_shards.size())
+    pthread_cond_wait(&m_changed, &m_mutex);
+  pthread_mutex_unlock(&m_mutex);
+}
+
+void Shard_dispatcher::dispatch(Row_event *row_event,
+                                Table_map_event *table_map)
+{
+  Row_index rows(row_event, table_map);
+  size_t count= m_shards.size();
+  Row_change change;
+  change.row_event= row_event;
+  change.table_map= table_map;
+
+  if (m_key->is_per_table())
+  {
+    size_t shard= m_key->hash(table_map, Row_image()) % count;
+    for (size_t n= 0; n < rows.size(); ++n)
+    {
+      change.before= rows.before(n);
+      change.after= rows.after(n);
+      push_row(shard, change);
+    }
+    return;
+  }
+
+  for (size_t n= 0; n < rows.size(); ++n)
+  {
+    change.before= rows.before(n);
+    change.after= rows.after(n);
+    size_t shard= m_key->hash(table_map, rows[n]) % count;
+    if (change.before.valid() && change.after.valid() &&
+        m_key->hash(table_map, change.before) % count != shard)
+    {
+      /*
+        The row moves to a key of another shard. It must come after the
+        changes of its old key and before those of its new key, so it is
+        applied while no other row is in flight.
+      */
+      barrier();
+      push_row(shard, change);
+      barrier();
+      continue;
+    }
+    push_row(shard, change);
+  }
+}
+
+void Shard_dispatcher::commit(Binary_log_event *event)
+{
+  add_watermark_entry(m_batch, event->header()->next_position);
+  if (m_batch)
+  {
+    m_batch->release();
+    m_batch= 0;
+  }
+  m_table_maps.clear();
+  m_in_transaction= false;
+}
+
+void Shard_dispatcher::add_watermark_entry(Batch *batch,
+                                           unsigned long position)
+{
+  Watermark_entry entry;
+  entry.applied= batch == 0;
+  entry.file= m_file;
+  entry.position= position;
+
+  pthread_mutex_lock(&m_mutex);
+  if (batch)
+    batch->set_sequence(m_first_sequence + m_watermark.size());
+  m_watermark.push_back(entry);
+  advance_watermark();
+  pthread_mutex_unlock(&m_mutex);
+}
+
+void Shard_dispatcher::batch_applied(uint64_t sequence)
+{
+  pthread_mutex_lock(&m_mutex);
+  /* A failure holds the watermark at the last transaction before it */
+  if (!m_failed)
+  {
+    m_watermark[sequence - m_first_sequence].applied= true;
+    advance_watermark();
+  }
+  pthread_mutex_unlock(&m_mutex);
+}
+
+void Shard_dispatcher::advance_watermark()
+{
+  if (m_failed || m_watermark.empty() || !m_watermark.front().applied)
+    return;
+  while (!m_watermark.empty() && m_watermark.front().applied)
+  {
+    m_applied_file.swap(m_watermark.front().file);
+    m_applied_position= m_watermark.front().position;
+    m_watermark.pop_front();
+    ++m_first_sequence;
+  }
+  pthread_cond_broadcast(&m_changed);
+}
+
+unsigned long Shard_dispatcher::applied_position(std::string &filename) const
+{
+  pthread_mutex_lock(&m_mutex);
+  filename= m_applied_file;
+  unsigned long position= m_applied_position;
+  pthread_mutex_unlock(&m_mutex);
+  return position;
+}
+
+unsigned long Shard_dispatcher::applied_position() const
+{
+  pthread_mutex_lock(&m_mutex);
+  unsigned long position= m_applied_position;
+  pthread_mutex_unlock(&m_mutex);
+  return position;
+}
+
+void Shard_dispatcher::wait_until_applied()
+{
+  pthread_mutex_lock(&m_mutex);
+  while (!m_watermark.empty() && !m_failed)
+    pthread_cond_wait(&m_changed, &m_mutex);
+  pthread_mutex_unlock(&m_mutex);
+}
+
+mysql::Binary_log_event *Shard_dispatcher::process_event(mysql::Query_event *ev)
+{
+  if (ev->query == "BEGIN")
+    m_in_transaction= true;
+  else if (ev->query == "COMMIT")
+    commit(ev);
+  else
+  {
+    /* Whoever comes next sees the statement after the rows before it */
+    barrier();
+    if (!m_in_transaction)
+      commit(ev);
+  }
+  return ev;
+}
+
+mysql::Binary_log_event *Shard_dispatcher::process_event(mysql::Row_event *ev)
+{
+  std::map<uint64_t, Table_map_event *>::iterator it=
+    m_table_maps.find(ev->table_id);
+  if (it == m_table_maps.end())
+    return ev;
+  current_batch()->add_event(ev);
+  dispatch(ev, it->second);
+  return 0;
+}
+
+mysql::Binary_log_event *Shard_dispatcher::process_event(mysql::Table_map_event *ev)
+{
+  current_batch()->add_event(ev);
+  m_table_maps[ev->table_id]= ev;
+  return 0;
+}
+
+mysql::Binary_log_event *Shard_dispatcher::process_event(mysql::Xid *ev)
+{
+  commit(ev);
+  return ev;
+}
+
+mysql::Binary_log_event *Shard_dispatcher::process_event(mysql::Rotate_event *ev)
+{
+  if (!ev->binlog_file.empty())
+    m_file= ev->binlog_file;
+  /* Nothing is in flight between binlog files */
+  if (!m_in_transaction && m_batch == 0)
+    add_watermark_entry(0, ev->binlog_pos);
+  return ev;
+}
+
+mysql::Binary_log_event *Shard_dispatcher::process_event(mysql::Binary_log_event *ev)
+{
+  switch (ev->get_event_type())
+  {
+  case TRANSACTION_BEGIN_EVENT:
+    m_in_transaction= true;
+    return ev;
+  case TRANSACTION_COMMIT_EVENT:
+    commit(ev);
+    return ev;
+  default:
+    break;
+  }
+
+  Transaction_log_event *trans= dynamic_cast<Transaction_log_event *>(ev);
+  if (trans == 0)
+    return ev;
+  process_transaction(trans);
+  return 0;
+}
+
+void Shard_dispatcher::process_transaction(Transaction_log_event *trans)
+{
+  current_batch();
+  {
+    /*
+      The events read from a spill file only live until the next one is
+      read, so their rows are applied before moving on.
+    */
+    Transaction_event_reader reader(trans);
+    bool spilled= trans->is_spilled();
+    while (Binary_log_event *event= reader.next())
+    {
+      if (!is_rows_event(event))
+        continue;
+      Row_event *row_event= static_cast<Row_event *>(event);
+      Table_map_event *table_map= reader.table_map(row_event->table_id);
+      if (table_map == 0)
+        continue;
+      dispatch(row_event, table_map);
+      if (spilled)
+        barrier();
+    }
+    if (reader.error())
+      fail(ERR_FAIL);
+  }
+  m_batch->add_event(trans);
+  commit(trans);
+}
+
+} // end namespace mysql
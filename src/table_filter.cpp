@@ -0,0 +1,113 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#include "table_filter.h"
+
+namespace mysql { namespace system {
+
+bool wild_match(const char *pattern, const char *pattern_end,
+                const char *str, const char *str_end)
+{
+  /*
+    Where to resume after the last '%': the pattern just after it and the
+    string position it is currently assumed to extend to.
+  */
+  const char *star= 0;
+  const char *star_str= 0;
+
+  while (str != str_end)
+  {
+    if (pattern != pattern_end && *pattern == '%')
+    {
+      star= ++pattern;
+      star_str= str;
+      continue;
+    }
+    if (pattern != pattern_end)
+    {
+      const char *p= pattern;
+      if (*p == '\\' && p + 1 != pattern_end)
+        ++p;
+      if ((*pattern == '_' && p == pattern) || *p == *str)
+      {
+        pattern= p + 1;
+        ++str;
+        continue;
+      }
+    }
+    if (star == 0)
+      return false;
+    /* Let the last '%' swallow one more character */
+    pattern= star;
+    str= ++star_str;
+  }
+
+  while (pattern != pattern_end && *pattern == '%')
+    ++pattern;
+  return pattern == pattern_end;
+}
+
+static bool wild_match(const std::string &pattern, const std::string &str)
+{
+  return wild_match(pattern.data(), pattern.data() + pattern.size(),
+                    str.data(), str.data() + str.size());
+}
+
+void Table_filter::include(const std::string &db_pattern,
+                           const std::string &table_pattern)
+{
+  Rule rule;
+  rule.db_pattern= db_pattern;
+  rule.table_pattern= table_pattern;
+  m_include.push_back(rule);
+}
+
+void Table_filter::exclude(const std::string &db_pattern,
+                           const std::string &table_pattern)
+{
+  Rule rule;
+  rule.db_pattern= db_pattern;
+  rule.table_pattern= table_pattern;
+  m_exclude.push_back(rule);
+}
+
+bool Table_filter::matches(const std::vector<Rule> &rules,
+                           const std::string &db_name,
+                           const std::string &table_name)
+{
+  for (std::vector<Rule>::const_iterator it= rules.begin();
+       it != rules.end(); ++it)
+  {
+    if (wild_match(it->db_pattern, db_name) &&
+        wild_match(it->table_pattern, table_name))
+      return true;
+  }
+  return false;
+}
+
+bool Table_filter::allows(const std::string &db_name,
+                          const std::string &table_name) const
+{
+  if (matches(m_exclude, db_name, table_name))
+    return false;
+  return m_include.empty() || matches(m_include, db_name, table_name);
+}
+
+} } // end namespace mysql::system
@@ -0,0 +1,452 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+#include <utility>
+
+#include "table_index.h"
+
+namespace mysql {
+
+Table_schema::Table_schema(const Table_map_event *table_map,
+                           uint64_t version)
+  : m_table_id(table_map->table_id), m_db_name(table_map->db_name),
+    m_table_name(table_map->table_name), m_version(version),
+    m_columns(table_map->columns), m_null_bits(table_map->null_bits),
+    m_plan(const_cast<Decode_plan *>(get_decode_plan(table_map)))
+{
+  m_plan->add_ref();
+}
+
+Table_schema::~Table_schema()
+{
+  m_plan->release();
+}
+
+bool Table_schema::matches(const Table_map_event *table_map) const
+{
+  return table_map->table_id == m_table_id &&
+         table_map->table_name == m_table_name &&
+         table_map->db_name == m_db_name &&
+         table_map->null_bits == m_null_bits &&
+         m_plan->matches(table_map);
+}
+
+namespace {
+
+typedef std::vector<std::pair<std::string, std::string> > Name_list;
+
+/** What a DDL statement may have changed */
+enum Ddl_scope
+{
+  /** Not a DDL statement, or one which doesn't touch tables */
+  DDL_NONE,
+  /** The tables in the name list; an empty table name means all of a db */
+  DDL_TABLES,
+  /** Anything */
+  DDL_ALL
+};
+
+/**
+  Just enough of a SQL scanner to find the tables a DDL statement names.
+*/
+class Ddl_scanner
+{
+public:
+  explicit Ddl_scanner(const std::string &query)
+    : m_pos(query.data()), m_end(query.data() + query.size())
+  {
+  }
+
+  /**
+    Consume the keyword if it is next.
+  */
+  bool word(const char *keyword)
+  {
+    skip_space();
+    size_t length= strlen(keyword);
+    if ((size_t)(m_end - m_pos) < length ||
+        strncasecmp(m_pos, keyword, length) != 0 ||
+        (m_pos + length < m_end && is_ident_char(m_pos[length])))
+      return false;
+    m_pos+= length;
+    return true;
+  }
+
+  bool punct(char c)
+  {
+    skip_space();
+    if (m_pos == m_end || *m_pos != c)
+      return false;
+    ++m_pos;
+    return true;
+  }
+
+  /**
+    Consume a possibly quoted identifier. Quoted strings are taken as
+    well, for the user names in DEFINER clauses.
+  */
+  bool ident(std::string &out)
+  {
+    skip_space();
+    out.clear();
+    if (m_pos < m_end && (*m_pos == '`' || *m_pos == '\'' || *m_pos == '"'))
+    {
+      char quote= *m_pos;
+      for (++m_pos; m_pos < m_end; ++m_pos)
+      {
+        if (*m_pos == quote)
+        {
+          if (m_pos + 1 < m_end && m_pos[1] == quote)
+            ++m_pos;
+          else
+          {
+            ++m_pos;
+            return true;
+          }
+        }
+        out+= *m_pos;
+      }
+      return false;
+    }
+    while (m_pos < m_end && is_ident_char(*m_pos))
+      out+= *m_pos++;
+    return !out.empty();
+  }
+
+  /**
+    Consume [db.]table, taking default_db if there is no database.
+  */
+  bool name(const std::string &default_db, Name_list &names)
+  {
+    std::string first, second;
+    if (!ident(first))
+      return false;
+    if (punct('.'))
+    {
+      if (!ident(second))
+        return false;
+      names.push_back(std::make_pair(first, second));
+    }
+    else
+      names.push_back(std::make_pair(default_db, first));
+    return true;
+  }
+
+  /**
+    Consume a list of names separated by commas or TO, as in DROP TABLE
+    and RENAME TABLE.
+  */
+  bool name_list(const std::string &default_db, Name_list &names)
+  {
+    do
+    {
+      if (!name(default_db, names))
+        return false;
+    } while (punct(',') || word("TO"));
+    return true;
+  }
+
+  /**
+    Skip ahead until after the keyword.
+  */
+  bool skip_past(const char *keyword)
+  {
+    std::string ignored;
+    while (!word(keyword))
+    {
+      if (!ident(ignored) && !skip_one())
+        return false;
+    }
+    return true;
+  }
+
+private:
+  static bool is_ident_char(char c)
+  {
+    return isalnum((unsigned char) c) || c == '_' || c == '$' ||
+           (unsigned char) c >= 0x80;
+  }
+
+  bool skip_one()
+  {
+    skip_space();
+    if (m_pos == m_end)
+      return false;
+    ++m_pos;
+    return true;
+  }
+
+  /**
+    Skip white space and comments. The body of a versioned comment is
+    read as part of the statement, as the server would.
+  */
+  void skip_space()
+  {
+    while (m_pos < m_end)
+    {
+      if (isspace((unsigned char) *m_pos))
+        ++m_pos;
+      else if (m_end - m_pos >= 3 && strncmp(m_pos, "/*!", 3) == 0)
+      {
+        for (m_pos+= 3; m_pos < m_end && isdigit((unsigned char) *m_pos);)
+          ++m_pos;
+      }
+      else if (m_end - m_pos >= 2 && strncmp(m_pos, "*/", 2) == 0)
+        m_pos+= 2;
+      else if (m_end - m_pos >= 2 && strncmp(m_pos, "/*", 2) == 0)
+      {
+        const char *close= m_pos + 2;
+        while (close + 1 < m_end && strncmp(close, "*/", 2) != 0)
+          ++close;
+        m_pos= close + 1 < m_end ? close + 2 : m_end;
+      }
+      else if (*m_pos == '#' ||
+               (m_end - m_pos >= 3 && strncmp(m_pos, "-- ", 3) == 0))
+      {
+        while (m_pos < m_end && *m_pos != '\n')
+          ++m_pos;
+      }
+      else
+        break;
+    }
+  }
+
+  const char *m_pos;
+  const char *m_end;
+};
+
+/**
+  The objects which ALTER, CREATE and DROP may name that no table map
+  event describes.
+*/
+bool is_other_object(Ddl_scanner &scanner)
+{
+  static const char *others[]= { "VIEW", "USER", "EVENT", "FUNCTION",
+                                 "PROCEDURE", "TRIGGER", "SERVER", "LOGFILE",
+                                 "TABLESPACE", "ROLE", 0 };
+  for (const char **other= others; *other; ++other)
+    if (scanner.word(*other))
+      return true;
+  return false;
+}
+
+Ddl_scope parse_ddl(const std::string &query, const std::string &default_db,
+                    Name_list &names)
+{
+  Ddl_scanner scanner(query);
+
+  if (scanner.word("RENAME"))
+  {
+    if (!scanner.word("TABLE") && !scanner.word("TABLES"))
+      return is_other_object(scanner) ? DDL_NONE : DDL_ALL;
+    return scanner.name_list(default_db, names) ? DDL_TABLES : DDL_ALL;
+  }
+
+  if (scanner.word("TRUNCATE"))
+  {
+    scanner.word("TABLE");
+    return scanner.name(default_db, names) ? DDL_TABLES : DDL_ALL;
+  }
+
+  bool is_create= false;
+  if (scanner.word("CREATE"))
+  {
+    is_create= true;
+    if (scanner.word("OR"))
+      scanner.word("REPLACE");
+  }
+  else if (!scanner.word("ALTER") && !scanner.word("DROP"))
+    return DDL_NONE;
+
+  /* The options of views, triggers and stored programs */
+  std::string ignored;
+  while (true)
+  {
+    if (scanner.word("ALGORITHM"))
+    {
+      scanner.punct('=');
+      scanner.ident(ignored);
+    }
+    else if (scanner.word("DEFINER"))
+    {
+      scanner.punct('=');
+      scanner.ident(ignored);
+      if (scanner.punct('@'))
+        scanner.ident(ignored);
+      else if (scanner.punct('('))
+        scanner.punct(')');                     // CURRENT_USER()
+    }
+    else if (scanner.word("SQL"))
+    {
+      scanner.word("SECURITY");
+      scanner.ident(ignored);
+    }
+    else
+      break;
+  }
+
+  if (!scanner.word("ONLINE"))
+    scanner.word("OFFLINE");
+  scanner.word("IGNORE");
+  scanner.word("TEMPORARY");
+  if (!scanner.word("UNIQUE") && !scanner.word("FULLTEXT"))
+    scanner.word("SPATIAL");
+
+  if (scanner.word("TABLE") || scanner.word("TABLES"))
+  {
+    if (scanner.word("IF"))
+    {
+      scanner.word("NOT");
+      scanner.word("EXISTS");
+    }
+    /* CREATE TABLE names one table and may continue with a column list */
+    bool parsed= is_create ? scanner.name(default_db, names) :
+                             scanner.name_list(default_db, names);
+    return parsed ? DDL_TABLES : DDL_ALL;
+  }
+
+  if (scanner.word("INDEX"))
+  {
+    return scanner.skip_past("ON") && scanner.name(default_db, names) ?
+           DDL_TABLES : DDL_ALL;
+  }
+
+  if (scanner.word("DATABASE") || scanner.word("SCHEMA"))
+  {
+    if (scanner.word("IF"))
+    {
+      scanner.word("NOT");
+      scanner.word("EXISTS");
+    }
+    std::string db;
+    if (!scanner.ident(db))
+      db= default_db;
+    names.push_back(std::make_pair(db, std::string()));
+    return DDL_TABLES;
+  }
+
+  return is_other_object(scanner) ? DDL_NONE : DDL_ALL;
+}
+
+} // end anonymous namespace
+
+Table_index::Table_index() : m_version(0)
+{
+  subscribe_overloads(handled_events);
+}
+
+Table_index::~Table_index()
+{
+  clear();
+}
+
+mysql::Binary_log_event *Table_index::process_event(mysql::Table_map_event *tm)
+{
+  Schema_map::iterator it= m_schemas.find(tm->table_id);
+  if (it == m_schemas.end() || !it->second->matches(tm))
+  {
+    /* A new table, or the table id is reused for another definition */
+    Table_schema *schema= new Table_schema(tm, ++m_version);
+    if (it != m_schemas.end())
+    {
+      it->second->release();
+      it->second= schema;
+    }
+    else
+      m_schemas.insert(std::make_pair(tm->table_id, schema));
+  }
+  else if (tm->decode_plan == 0)
+  {
+    Decode_plan *plan= const_cast<Decode_plan *>(it->second->decode_plan());
+    plan->add_ref();
+    tm->decode_plan= plan;
+  }
+  return tm;
+}
+
+mysql::Binary_log_event *Table_index::process_event(mysql::Query_event *qev)
+{
+  if (m_schemas.empty())
+    return qev;
+
+  Name_list names;
+  switch (parse_ddl(qev->query, qev->db_name, names))
+  {
+  case DDL_NONE:
+    break;
+  case DDL_TABLES:
+    for (Name_list::iterator it= names.begin(); it != names.end(); ++it)
+      invalidate(it->first, it->second);
+    break;
+  case DDL_ALL:
+    clear();
+    break;
+  }
+  return qev;
+}
+
+const Table_schema *Table_index::find(uint64_t table_id) const
+{
+  Schema_map::const_iterator it= m_schemas.find(table_id);
+  return it == m_schemas.end() ? 0 : it->second;
+}
+
+int Table_index::get_table_name(uint64_t table_id, std::string &out) const
+{
+  const Table_schema *schema= find(table_id);
+  if (schema == 0)
+    return 1;
+  out= schema->db_name();
+  out.append(".");
+  out.append(schema->table_name());
+  return 0;
+}
+
+void Table_index::invalidate(const std::string &db_name,
+                             const std::string &table_name)
+{
+  Schema_map::iterator it= m_schemas.begin();
+  while (it != m_schemas.end())
+  {
+    Table_schema *schema= it->second;
+    if (strcasecmp(schema->db_name().c_str(), db_name.c_str()) == 0 &&
+        (table_name.empty() ||
+         strcasecmp(schema->table_name().c_str(), table_name.c_str()) == 0))
+    {
+      schema->release();
+      m_schemas.erase(it++);
+    }
+    else
+      ++it;
+  }
+}
+
+void Table_index::clear()
+{
+  for (Schema_map::iterator it= m_schemas.begin(); it != m_schemas.end();
+       ++it)
+    it->second->release();
+  m_schemas.clear();
+}
+
+} // end namespace mysql
@@ -28,12 +28,15 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
 #include <stdio.h>
 #include <functional>
 #include <pthread.h>
+#include <sched.h>
 #include <exception>
+#include <algorithm>
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 
 #include "tcp_driver.h"
 #include "protocol.h"
+#include "logging.h"
 #include "binlog_event.h"
 #include "rowset.h"
 #include "field_iterator.h"
@@ -119,11 +122,14 @@ tcp::socket *sync_connect_and_authenticate(asio::io_service &io_service, const s
   }
   } catch(...)
   {
+    MRL_ERROR("Failed to resolve " << host);
     return 0;
   }
 
   if (error)
   {
+    MRL_ERROR("Failed to connect to " << host << ":" << port << ": "
+              << error.message());
     return 0;
   }
 
@@ -265,13 +271,9 @@ void Binlog_tcp_driver::start_binlog_dump(const std::string &binlog_file_name, s
   /*
    Start receiving binlog events.
    */
-  if (!m_shutdown) {
-      Read_handler read_handler;
-      read_handler.method     = &Binlog_tcp_driver::handle_net_packet_header;
-      read_handler.tcp_driver = this;
-      asio::async_read(*m_socket, asio::buffer(m_net_header, 4),
-          read_handler);
-  }
+  reset_recv_block();
+  if (!m_shutdown)
+    post_net_read();
 
   /*
    Start the event loop in a new thread
@@ -279,156 +281,202 @@ void Binlog_tcp_driver::start_binlog_dump(const std::string &binlog_file_name, s
   if (!m_event_loop) {
       this->thread_data->tcp_driver = this;
       m_event_loop = (pthread_t *)malloc(sizeof(pthread_t));
+      __atomic_store_n(&m_event_loop_done, 0, __ATOMIC_RELEASE);
       pthread_create(m_event_loop, NULL, &Binlog_tcp_driver::start, (void *)this->thread_data);
   }
 }
 
-/**
- Helper function used to extract the event header from a memory block
- */
-static void proto_event_packet_header(asio::streambuf &event_src, Log_event_header *h)
+void Binlog_tcp_driver::post_net_read()
 {
-  std::istream is(&event_src);
-
-  Protocol_chunk<uint8_t> prot_marker(h->marker);
-  Protocol_chunk<uint32_t> prot_timestamp(h->timestamp);
-  Protocol_chunk<uint8_t> prot_type_code(h->type_code);
-  Protocol_chunk<uint32_t> prot_server_id(h->server_id);
-  Protocol_chunk<uint32_t> prot_event_length(h->event_length);
-  Protocol_chunk<uint32_t> prot_next_position(h->next_position);
-  Protocol_chunk<uint16_t> prot_flags(h->flags);
-
-  is >> prot_marker
-          >> prot_timestamp
-          >> prot_type_code
-          >> prot_server_id
-          >> prot_event_length
-          >> prot_next_position
-          >> prot_flags;
+  Read_handler read_handler;
+  read_handler.method     = &Binlog_tcp_driver::handle_net_read;
+  read_handler.tcp_driver = this;
+  m_socket->async_read_some(asio::buffer(m_recv_block->data() + m_recv_end,
+                                         m_recv_block->capacity() - m_recv_end),
+                            read_handler);
 }
 
-void Binlog_tcp_driver::handle_net_packet(const asio::error_code& err, std::size_t bytes_transferred)
+void Binlog_tcp_driver::handle_net_read(const asio::error_code& err, std::size_t bytes_transferred)
 {
   if (err)
   {
     Binary_log_event * ev= create_incident_event(175, err.message().c_str(), m_binlog_offset);
-    std::cout << "1:" << err.message() << std::endl;
+    MRL_ERROR("Binlog stream read failed: " << err.message());
     m_event_queue->push_front(ev);
     return;
   }
 
-  if (bytes_transferred > MAX_PACKAGE_SIZE || bytes_transferred == 0)
-  {
-    std::ostringstream os;
-    os << "Expected byte size to be between 0 and "
-       << MAX_PACKAGE_SIZE
-       << " number of bytes; got "
-       << bytes_transferred
-       << " instead.";
-    Binary_log_event * ev= create_incident_event(175, os.str().c_str(), m_binlog_offset);
-    std::cout << "2:" << os.str() << std::endl;
-    m_event_queue->push_front(ev);
-    return;
-  }
+  m_recv_end+= bytes_transferred;
+  m_total_bytes_transferred+= bytes_transferred;
 
-  //assert(m_waiting_event != 0);
-  //std::cerr << "Committing '"<< bytes_transferred << "' bytes to the event stream." << std::endl;
-  m_event_stream_buffer.commit(bytes_transferred);
   /*
-    If the event object doesn't have an event length it means that the header
-    hasn't been parsed. If the event stream also contains enough bytes
-    we make the assumption that the next bytes waiting in the stream is
-    the event header and attempt to parse it.
-   */
-  if (m_waiting_event->event_length == 0 && m_event_stream_buffer.size() >= 19)
+    Split off every complete package in the buffer. The package header is
+    a 3 byte length followed by the package sequence number.
+  */
+  std::size_t packet_length= 0;
+  while (m_recv_end - m_recv_begin >= 4)
   {
-    /*
-      Copy and remove from the event stream, the remaining bytes might be
-      dynamic payload.
-     */
-    //std::cerr << "Consuming event stream for header. Size before: " << m_event_stream_buffer.size() << std::endl;
-    proto_event_packet_header(m_event_stream_buffer, m_waiting_event);
-    //std::cerr << " Size after: " << m_event_stream_buffer.size() << std::endl;
+    const unsigned char *net_header=
+      (const unsigned char *)m_recv_block->data() + m_recv_begin;
+    packet_length= (std::size_t) net_header[0];
+    packet_length+= (std::size_t) (net_header[1] << 8);
+    packet_length+= (std::size_t) (net_header[2] << 16);
+
+    // TODO validate packet sequence numbers
+    //int packet_no=(unsigned char) net_header[3];
+
+    if (m_recv_end - m_recv_begin < packet_length + 4)
+      break;
+
+    handle_net_packet(m_recv_block->data() + m_recv_begin + 4, packet_length);
+    m_recv_begin+= packet_length + 4;
+    packet_length= 0;
   }
 
-  //std::cerr << "Event length: " << m_waiting_event->header()->event_length << " and available payload size is " << m_event_stream_buffer.size()+LOG_EVENT_HEADER_SIZE-1 <<  std::endl;
-  if (m_waiting_event->event_length == m_event_stream_buffer.size() + LOG_EVENT_HEADER_SIZE - 1)
+  /*
+    Keep reading into the free tail of the block as long as the pending
+    package fits. Otherwise continue in a block which can hold the whole
+    package; the current block stays alive for as long as events refer
+    to it.
+  */
+  std::size_t pending= m_recv_end - m_recv_begin;
+  std::size_t capacity= m_recv_block->capacity();
+  std::size_t needed= packet_length + 4;
+  if (m_recv_begin + needed > capacity ||
+      (m_recv_begin > 0 && capacity - m_recv_end < RECV_LOW_WATER))
   {
-    /*
-     If the header length equals the size of the payload plus the
-     size of the header, the event object is complete.
-     Next we need to parse the payload buffer
-     */
-    std::istream is(&m_event_stream_buffer);
-    Binary_log_event * event= parse_event(is, m_waiting_event);
+    if (needed <= RECV_BUFFER_SIZE && capacity == RECV_BUFFER_SIZE &&
+        m_recv_block->is_unique())
+    {
+      memmove(m_recv_block->data(), m_recv_block->data() + m_recv_begin,
+              pending);
+    }
+    else
+    {
+      Event_buffer *block= needed > RECV_BUFFER_SIZE ?
+                           new Event_buffer(needed) : m_recv_pool->get();
+      memcpy(block->data(), m_recv_block->data() + m_recv_begin, pending);
+      m_recv_block->release();
+      m_recv_block= block;
+    }
+    m_recv_begin= 0;
+    m_recv_end= pending;
+  }
 
-    m_event_stream_buffer.consume(m_event_stream_buffer.size());
+  if (!m_shutdown)
+    post_net_read();
+}
 
-    m_event_queue->push_front(event);
+void Binlog_tcp_driver::handle_net_packet(const char *packet, std::size_t packet_length)
+{
+  if (m_skip_packets)
+  {
+    m_skip_packets= packet_length == MAX_PACKAGE_SIZE;
+    return;
+  }
 
-    /*
-      Note on memory management: The pushed Binary_log_event will be
-      deleted in user land.
-    */
-    delete m_waiting_event;
-    m_waiting_event= 0;
+  /*
+    Drop a large event which isn't subscribed, or which belongs to an
+    excluded table, before its packages are joined. The type code follows
+    the marker byte and the timestamp.
+  */
+  if (packet_length == MAX_PACKAGE_SIZE && m_event_block == 0 &&
+      (!is_subscribed((unsigned char) packet[5]) ||
+       is_excluded_rows_event((unsigned char) packet[5],
+                              packet + LOG_EVENT_HEADER_SIZE,
+                              packet_length - LOG_EVENT_HEADER_SIZE)))
+  {
+    m_skip_packets= true;
+    return;
   }
 
-  if (!m_shutdown) {
-      Read_handler read_handler;
-      read_handler.method     = &Binlog_tcp_driver::handle_net_packet_header;
-      read_handler.tcp_driver = this;
-      asio::async_read(*m_socket, asio::buffer(m_net_header, 4),
-          read_handler);
+  /*
+    A package of maximum size means that the event continues in the next
+    package.
+  */
+  if (packet_length == MAX_PACKAGE_SIZE || m_event_block)
+  {
+    std::size_t needed= m_event_size + packet_length;
+    if (m_event_block == 0)
+    {
+      /*
+        Size the block from the event length in the event header, which
+        follows the marker byte and the 4 byte timestamp, type code and
+        server id.
+      */
+      const unsigned char *len= (const unsigned char *)packet + 10;
+      std::size_t event_length= (std::size_t) len[0] +
+                                ((std::size_t) len[1] << 8) +
+                                ((std::size_t) len[2] << 16) +
+                                ((std::size_t) len[3] << 24);
+      m_event_block= new Event_buffer(std::max(needed, event_length + 1));
+    }
+    else if (needed > m_event_block->capacity())
+    {
+      Event_buffer *block= new Event_buffer(needed * 2);
+      memcpy(block->data(), m_event_block->data(), m_event_size);
+      m_event_block->release();
+      m_event_block= block;
+    }
+    memcpy(m_event_block->data() + m_event_size, packet, packet_length);
+    m_event_size= needed;
+    if (packet_length == MAX_PACKAGE_SIZE)
+      return;
+    handle_event_packet(m_event_block->data(), m_event_size, m_event_block);
+    m_event_block->release();
+    m_event_block= 0;
+    m_event_size= 0;
+    return;
   }
+
+  handle_event_packet(packet, packet_length, m_recv_block);
 }
 
-void Binlog_tcp_driver::handle_net_packet_header(const asio::error_code& err, std::size_t bytes_transferred)
+void Binlog_tcp_driver::handle_event_packet(const char *packet, std::size_t packet_length,
+                                            Event_buffer *owner)
 {
-  if (err)
+  if ((unsigned char) packet[0] == 0xFF && packet_length >= 9)
   {
-    Binary_log_event * ev= create_incident_event(175, err.message().c_str(), m_binlog_offset);
-    std::cout << "3:" << err.message() << std::endl;
+    /* The server sent an error package instead of an event */
+    Memory_streambuf packet_buffer(packet + 1, packet_length - 1);
+    std::istream is(&packet_buffer);
+    struct st_error_package error_package;
+    prot_parse_error_message(is, error_package, packet_length - 1);
+    Binary_log_event * ev= create_incident_event(175, error_package.message.c_str(), m_binlog_offset);
+    MRL_ERROR("Server sent error instead of event: "
+              << error_package.message);
     m_event_queue->push_front(ev);
     return;
   }
 
-  if (bytes_transferred != 4)
+  if (packet_length < LOG_EVENT_HEADER_SIZE)
   {
     std::ostringstream os;
-    os << "Expected byte size to be between 0 and "
+    os << "Expected byte size to be between "
+       << LOG_EVENT_HEADER_SIZE << " and "
        << MAX_PACKAGE_SIZE
        << " number of bytes; got "
-       << bytes_transferred
+       << packet_length
        << " instead.";
     Binary_log_event * ev= create_incident_event(175, os.str().c_str(), m_binlog_offset);
-    std::cout << "4:" << os.str() << std::endl;
+    MRL_ERROR(os.str());
     m_event_queue->push_front(ev);
     return;
   }
 
-  int packet_length=(unsigned long) (m_net_header[0] &0xFF);
-  packet_length+=(unsigned long) ((m_net_header[1] &0xFF) << 8);
-  packet_length+=(unsigned long) ((m_net_header[2] &0xFF) << 16);
-
-  // TODO validate packet sequence numbers
-  //int packet_no=(unsigned char) m_net_header[3];
-
-  if (m_waiting_event == 0)
-  {
-    //std::cerr << "event_stream_buffer.size= " << m_event_stream_buffer.size() << std::endl;
-    m_waiting_event= new Log_event_header();
-    m_event_packet=  asio::buffer_cast<char *>(m_event_stream_buffer.prepare(packet_length));
-    //assert(m_event_stream_buffer.size() == 0);
-  }
-
+  Buffer_decoder dec(packet, packet_length, owner);
+  Log_event_header header;
+  dec.read(header.marker);
+  proto_event_header(dec, &header);
+  Binary_log_event * event= parse_event(dec, &header);
+  if (event == 0)
+    return;
 
-  Read_handler read_handler;
-  read_handler.method     = &Binlog_tcp_driver::handle_net_packet;
-  read_handler.tcp_driver = this;
-  asio::async_read(*m_socket,
-                          asio::buffer(m_event_packet, packet_length),
-                          read_handler);
+  /*
+    Note on memory management: The pushed Binary_log_event will be
+    deleted in user land.
+  */
+  m_event_queue->push_front(event);
 }
 
     int authenticate(tcp::socket *socket, const std::string& user, const std::string& passwd,
@@ -511,13 +559,15 @@ void Binlog_tcp_driver::handle_net_packet_header(const asio::error_code& err, st
     {
       struct st_error_package error_package;
       prot_parse_error_message(auth_response_stream, error_package, packet_length);
+      MRL_ERROR("Authentication failed: " << error_package.message);
       return 1;
     }
 
     return 0;
   } catch (asio::system_error e)
   {
-    // TODO log error; adjust return code
+    // TODO adjust return code
+    MRL_ERROR("Authentication failed: " << e.what());
     return 1;
   }
 }
@@ -528,7 +578,8 @@ int Binlog_tcp_driver::wait_for_next_event(mysql::Binary_log_event **event_ptr)
   // return the event
   if (event_ptr)
     *event_ptr = 0;
-  m_event_queue->pop_back(event_ptr);
+  if (!m_event_queue->wait_pop(event_ptr))
+    return ERR_EOF;                             // Interrupted
   return 0;
 }
 
@@ -536,6 +587,8 @@ void *Binlog_tcp_driver::start(void *data)
 {
    Thread_data *thread_data = (Thread_data *)data;
    thread_data->tcp_driver->start_event_loop();
+   __atomic_store_n(&thread_data->tcp_driver->m_event_loop_done, 1,
+                    __ATOMIC_RELEASE);
    return NULL;
 }
 
@@ -589,19 +642,35 @@ void Binlog_tcp_driver::reconnect()
 
 void Binlog_tcp_driver::disconnect()
 {
-  Binary_log_event * event;
-  m_waiting_event= 0;
-  m_event_stream_buffer.consume(m_event_stream_buffer.in_avail());
-  while(m_event_queue->has_unread())
-  {
-    m_event_queue->pop_back(&event);
-    delete(event);
-  }
+  reset_recv_block();
+  if (m_event_block)
+    m_event_block->release();
+  m_event_block= 0;
+  m_event_size= 0;
   if (m_socket)
     m_socket->close();
   m_socket= 0;
 }
 
+void Binlog_tcp_driver::reset_recv_block()
+{
+  if (!m_recv_block->is_unique() ||
+      m_recv_block->capacity() != RECV_BUFFER_SIZE)
+  {
+    m_recv_block->release();
+    m_recv_block= m_recv_pool->get();
+  }
+  m_recv_begin= 0;
+  m_recv_end= 0;
+}
+
+void Binlog_tcp_driver::drain_event_queue()
+{
+  Binary_log_event * event;
+  while(m_event_queue->try_pop(&event))
+    delete(event);
+}
+
 
 void Binlog_tcp_driver::shutdown(void)
 {
@@ -653,11 +722,21 @@ int Binlog_tcp_driver::set_position(const std::string &str, unsigned long positi
   m_io_service.post(shutdown_handler);
   if (m_event_loop)
   {
+    /*
+      The event loop can't handle the shutdown while it waits for room in
+      a full event queue, so keep emptying the queue until it is done.
+    */
+    while (!__atomic_load_n(&m_event_loop_done, __ATOMIC_ACQUIRE))
+    {
+      drain_event_queue();
+      sched_yield();
+    }
     pthread_join(*m_event_loop, NULL);
     free(m_event_loop);
   }
   m_event_loop= 0;
   disconnect();
+  drain_event_queue();
   /*
     Uppon return of connect we only know if we succesfully authenticated
     against the server. The binlog dump command is executed asynchronously
@@ -0,0 +1,236 @@
+/*
+Copyright (c) 2003, 2011, Oracle and/or its affiliates. All rights
+reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; version 2 of
+the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+02110-1301  USA
+*/
+
+#include "binlog_api.h"
+#include "threaded_pipeline.h"
+#include "event_pool.h"
+
+namespace mysql {
+
+Threaded_pipeline::Threaded_pipeline(system::Binary_log_driver *driver,
+                                     const std::vector<Content_handler *> &handlers,
+                                     size_t queue_size)
+  : m_driver(driver), m_running(false), m_stopping(0), m_draining(0),
+    m_error(ERR_OK)
+{
+  m_queues.push_back(new Item_queue(queue_size));
+  for (size_t i= 0; i < handlers.size(); ++i)
+  {
+    m_queues.push_back(new Item_queue(queue_size));
+    Stage stage;
+    stage.pipeline= this;
+    stage.handler= handlers[i];
+    stage.events= handlers[i]->subscribed_events();
+    stage.input= m_queues[i];
+    stage.output= m_queues[i + 1];
+    m_stages.push_back(stage);
+  }
+}
+
+Threaded_pipeline::~Threaded_pipeline()
+{
+  stop();
+  for (size_t i= 0; i < m_queues.size(); ++i)
+    delete m_queues[i];
+}
+
+int Threaded_pipeline::start()
+{
+  if (m_running)
+    return 0;
+
+  m_stopping= 0;
+  m_draining= 0;
+  m_error= ERR_OK;
+  for (size_t i= 0; i < m_queues.size(); ++i)
+    m_queues[i]->reopen();
+  m_running= true;
+
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, &Threaded_pipeline::run_reader, this))
+  {
+    stop();
+    return 1;
+  }
+  m_threads.push_back(thread);
+  for (size_t i= 0; i < m_stages.size(); ++i)
+  {
+    if (pthread_create(&thread, NULL, &Threaded_pipeline::run_stage,
+                       &m_stages[i]))
+    {
+      stop();
+      return 1;
+    }
+    m_threads.push_back(thread);
+  }
+  return 0;
+}
+
+void Threaded_pipeline::stop()
+{
+  if (!m_running)
+    return;
+
+  __atomic_store_n(&m_stopping, 1, __ATOMIC_RELEASE);
+  m_driver->interrupt();
+  for (size_t i= 0; i < m_queues.size(); ++i)
+    m_queues[i]->close();
+  for (size_t i= 0; i < m_threads.size(); ++i)
+    pthread_join(m_threads[i], NULL);
+  m_threads.clear();
+  m_driver->resume();
+
+  /* All threads are gone, so any thread may empty the queues */
+  Pipeline_item item;
+  for (size_t i= 0; i < m_queues.size(); ++i)
+    while (m_queues[i]->try_pop(&item))
+      if (item.event)
+        release_event(item.event);
+  m_running= false;
+}
+
+void Threaded_pipeline::drain(std::list<Binary_log_event *> &events)
+{
+  if (!m_running)
+    return;
+
+  /*
+    The reader ends the stream before its next read, or as soon as an
+    interrupted driver returns. The queues stay open so that the events
+    on their way get through all handlers.
+  */
+  __atomic_store_n(&m_draining, 1, __ATOMIC_RELEASE);
+  m_driver->interrupt();
+  Pipeline_item item;
+  while (m_error == ERR_OK && m_queues.back()->wait_pop(&item) && item.event)
+    events.push_back(item.event);
+  stop();
+}
+
+int Threaded_pipeline::wait_for_next_event(Binary_log_event **event)
+{
+  if (m_error != ERR_OK)
+    return m_error;
+
+  Pipeline_item item;
+  if (!m_queues.back()->wait_pop(&item))
+    return ERR_FAIL;
+  if (item.event == 0)
+  {
+    m_error= item.error;
+    return m_error;
+  }
+  *event= item.event;
+  return ERR_OK;
+}
+
+void *Threaded_pipeline::run_reader(void *arg)
+{
+  Threaded_pipeline *pipeline= static_cast<Threaded_pipeline *>(arg);
+  Item_queue *output= pipeline->m_queues.front();
+
+  while (!pipeline->stopping())
+  {
+    Binary_log_event *event= 0;
+    int error= ERR_OK;
+    if (!pipeline->draining())
+      error= pipeline->m_driver->wait_for_next_event(&event);
+    if (error == ERR_OK && event == 0)
+      error= ERR_FAIL;
+    /* The end of a drained stream */
+    if (pipeline->draining() && error != ERR_OK)
+      error= ERR_EOF;
+    Pipeline_item item;
+    item.event= error == ERR_OK ? event : 0;
+    item.error= error;
+    if (!output->wait_push(item))
+    {
+      if (item.event)
+        release_event(item.event);
+      break;
+    }
+    if (error != ERR_OK)
+      break;
+  }
+  return NULL;
+}
+
+void *Threaded_pipeline::run_stage(void *arg)
+{
+  Stage *stage= static_cast<Stage *>(arg);
+  Pipeline_item item;
+
+  while (stage->input->wait_pop(&item))
+  {
+    if (stage->pipeline->stopping())
+    {
+      if (item.event)
+        release_event(item.event);
+      break;
+    }
+    if (item.event == 0)
+    {
+      /* The end of the stream goes on to the consumer */
+      stage->output->wait_push(item);
+      break;
+    }
+    if (!stage->pipeline->process(stage, item.event))
+      break;
+  }
+  return NULL;
+}
+
+/**
+  Run an event and the events injected meanwhile through the handler of
+  a stage and pass the results on.
+
+  @return False if the pipeline is stopping
+*/
+bool Threaded_pipeline::process(Stage *stage, Binary_log_event *event)
+{
+  Injection_queue injected;
+  Content_handler *handler= stage->handler;
+  bool passing= true;
+
+  handler->set_injection_queue(&injected);
+  while (true)
+  {
+    if (passing && stage->events.test(event->header()->type_code))
+      event= handler->internal_process_event(event);
+    if (event)
+    {
+      Pipeline_item item;
+      item.event= event;
+      item.error= ERR_OK;
+      if (!passing || !stage->output->wait_push(item))
+      {
+        release_event(event);
+        passing= false;
+      }
+    }
+    if (injected.empty())
+      break;
+    event= injected.front();
+    injected.pop_front();
+  }
+  return passing;
+}
+
+} // end namespace mysql
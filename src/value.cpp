@@ -119,7 +119,7 @@ int calc_field_size(unsigned char column_type, const unsigned char *field_ptr, u
   {
     length= metadata > 255 ? 2 : 1;
 
-    length+= length == 1 ? (uint32_t) *field_ptr : *((uint16_t *)field_ptr);
+    length+= length == 1 ? (uint32_t) *field_ptr : Int_reader<2>::load(field_ptr);
 
     break;
   }
@@ -135,15 +135,13 @@ int calc_field_size(unsigned char column_type, const unsigned char *field_ptr, u
         length= 1+ (uint32_t) field_ptr[0];
         break;
       case 2:
-        length= 2+ (uint32_t) (*(uint16_t *)(field_ptr) & 0xFFFF);
+        length= 2+ (uint32_t) Int_reader<2>::load(field_ptr);
         break;
       case 3:
-        // TODO make platform indep.
-        length= 3+ (uint32_t) (long) (*((uint32_t *) (field_ptr)) & 0xFFFFFF);
+        length= 3+ Int_reader<3>::load(field_ptr);
         break;
       case 4:
-        // TODO make platform indep.
-        length= 4+ (uint32_t) (long) *((uint32_t *) (field_ptr));
+        length= 4+ Int_reader<4>::load(field_ptr);
         break;
       default:
         length= 0;
@@ -250,12 +248,7 @@ int32_t Value::as_int32() const
   {
     return 0;
   }
-  uint32_t to_int;
-  Protocol_chunk<uint32_t> prot_integer(to_int);
-
-  buffer_source buff(m_storage, m_size);
-  buff >> prot_integer;
-  return to_int;
+  return (int32_t) Int_reader<4>::load((const unsigned char *)m_storage);
 }
 
 int8_t Value::as_int8() const
@@ -264,12 +257,7 @@ int8_t Value::as_int8() const
   {
     return 0;
   }
-  int8_t to_int;
-  Protocol_chunk<int8_t> prot_integer(to_int);
-
-  buffer_source buff(m_storage, m_size);
-  buff >> prot_integer;
-  return to_int;
+  return (int8_t) Int_reader<1>::load((const unsigned char *)m_storage);
 }
 
 int16_t Value::as_int16() const
@@ -278,12 +266,7 @@ int16_t Value::as_int16() const
   {
     return 0;
   }
-  int16_t to_int;
-  Protocol_chunk<int16_t> prot_integer(to_int);
-
-  buffer_source buff(m_storage, m_size);
-  buff >> prot_integer;
-  return to_int;
+  return (int16_t) Int_reader<2>::load((const unsigned char *)m_storage);
 }
 
 int64_t Value::as_int64() const
@@ -292,12 +275,7 @@ int64_t Value::as_int64() const
   {
     return 0;
   }
-  int64_t to_int;
-  Protocol_chunk<int64_t> prot_integer(to_int);
-
-  buffer_source buff(m_storage, m_size);
-  buff >> prot_integer;
-  return to_int;
+  return (int64_t) Int_reader<8>::load((const unsigned char *)m_storage);
 }
 
 float Value::as_float() const